@@ -0,0 +1,542 @@
+#include <alloc.h>
+#include <dynarray/dynarray.h>
+#include <fcntl.h>
+#include <generator.h>
+#include <inttypes.h>
+#include <lexer.h>
+#include <lexer_baseline.h>
+#include <math.h>
+#include <session.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sv/sv.h>
+#include <time.h>
+#include <timing.h>
+#include <unistd.h>
+
+// Compiles a generated program repeatedly on a fresh session each run and
+// reports each phase's time and the compiler's throughput as a mean and
+// standard deviation over the runs, then times dynarray and sv on their own.
+// With --lexers it instead compares the lexer with the one it replaced, and
+// with -j it reports lexing throughput for every thread count up to N.
+
+static void usage(const char* program) {
+    fprintf(stderr, "usage: %s [-r runs] [-f functions] [-d depth] [-w width] [-i identifier length]\n", program);
+    fprintf(stderr, "       %*s [-l lets] [-c comments] [-s seed] [--emit file] [--no-micro] [--lexers] [-j threads]\n", (int) strlen(program), "");
+}
+
+typedef struct {
+    double sum;
+    double squares;
+    uint32_t count;
+} sample_t;
+
+static void sample_add(sample_t* sample, double value) {
+    sample->sum += value;
+    sample->squares += value * value;
+    sample->count++;
+}
+
+static double sample_mean(const sample_t* sample) {
+    return sample->count ? sample->sum / sample->count : 0;
+}
+
+static double sample_stddev(const sample_t* sample) {
+    if (sample->count < 2) {
+        return 0;
+    }
+
+    double mean = sample_mean(sample);
+    double variance = (sample->squares - sample->count * mean * mean) / (sample->count - 1);
+
+    return variance > 0 ? sqrt(variance) : 0;
+}
+
+static void sample_print(const char* name, const sample_t* sample, const char* unit) {
+    double mean = sample_mean(sample);
+    double stddev = sample_stddev(sample);
+
+    printf("%-16s %14.3f %12.3f %7.1f%%  %s\n", name, mean, stddev, mean ? stddev / mean * 100 : 0, unit);
+}
+
+static void header(const char* title) {
+    printf("%-16s %14s %12s %8s\n", title, "mean", "stddev", "rsd");
+}
+
+// The phases as the harness reports them. Signatures are part of checking
+// and writing the assembly out part of emitting.
+typedef enum {
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_CHECK,
+    PHASE_FOLD,
+    PHASE_EMIT,
+    PHASE_COUNT,
+} phase_t;
+
+static const char* phase_names[PHASE_COUNT] = {
+    [PHASE_LEX]   = "lex",
+    [PHASE_PARSE] = "parse",
+    [PHASE_CHECK] = "check",
+    [PHASE_FOLD]  = "fold",
+    [PHASE_EMIT]  = "emit",
+};
+
+static const phase_t pass_phases[PASS_COUNT] = {
+    [PASS_LEX]        = PHASE_LEX,
+    [PASS_PARSE]      = PHASE_PARSE,
+    [PASS_SIGNATURES] = PHASE_CHECK,
+    [PASS_CHECK]      = PHASE_CHECK,
+    [PASS_FOLD]       = PHASE_FOLD,
+    [PASS_CODEGEN]    = PHASE_EMIT,
+    [PASS_OUTPUT]     = PHASE_EMIT,
+};
+
+static bool bench_compiler(const char* data, size_t size, uint32_t functions, int runs) {
+    int sink = open("/dev/null", O_WRONLY);
+    emitter_t output;
+    emitter_init(&output);
+
+    sample_t phases[PHASE_COUNT] = { 0 };
+    sample_t total = { 0 };
+    sample_t bytes = { 0 };
+    sample_t tokens = { 0 };
+    sample_t compiled = { 0 };
+
+    // The first run only warms up caches and the allocator.
+    for (int run = 0; run <= runs; run++) {
+        pass_report_t report;
+        pass_report_init(&report);
+
+        session_t session;
+        session_init(&session, 1, NULL, &report, OUTPUT_ASSEMBLY);
+        emitter_clear(&output);
+        bool ok = session_compile(&session, data, size, &output, stderr);
+        session_deinit(&session);
+
+        if (!ok) {
+            fprintf(stderr, "ERROR: generated program did not compile\n");
+            emitter_deinit(&output);
+            close(sink);
+            return false;
+        }
+
+        pass_clock_t start = pass_begin(false);
+        emitter_write(&output, sink);
+        pass_end(&report, PASS_OUTPUT, start);
+
+        if (run == 0) {
+            continue;
+        }
+
+        double times[PHASE_COUNT] = { 0 };
+        for (int i = PASS_LEX; i < PASS_COUNT; i++) {
+            times[pass_phases[i]] += report.passes[i].wall;
+        }
+
+        double seconds = 0;
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            sample_add(&phases[i], times[i] * 1e3);
+            seconds += times[i];
+        }
+
+        sample_add(&total, seconds * 1e3);
+        sample_add(&bytes, size / seconds / 1e6);
+        sample_add(&tokens, report.tokens / seconds / 1e6);
+        sample_add(&compiled, functions / seconds / 1e3);
+
+        if (run == 1) {
+            printf("input: %zu bytes, %"PRIu64" tokens, %"PRIu64" nodes, %"PRIu32" functions, %d runs\n\n", size, report.tokens, report.nodes, functions, runs);
+        }
+    }
+
+    emitter_deinit(&output);
+    close(sink);
+
+    header("phase");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        sample_print(phase_names[i], &phases[i], "ms");
+    }
+    sample_print("total", &total, "ms");
+
+    printf("\n");
+    header("throughput");
+    sample_print("source", &bytes, "MB/s");
+    sample_print("tokens", &tokens, "Mtokens/s");
+    sample_print("functions", &compiled, "kfunctions/s");
+
+    return true;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Keeps results alive so the loops under test are not optimized away.
+static volatile size_t sink_value;
+
+#define MICRO_OPERATIONS 1000000
+
+static void micro_dynarray_push(size_t operations) {
+    int* values = dynarray_create(int);
+    for (size_t i = 0; i < operations; i++) {
+        dynarray_push_rval(values, (int) i);
+    }
+
+    sink_value += dynarray_length(values);
+    dynarray_destroy(values);
+}
+
+static void micro_dynarray_push_prealloc(size_t operations) {
+    int* values = dynarray_create_prealloc(int, operations);
+    for (size_t i = 0; i < operations; i++) {
+        dynarray_push_rval(values, (int) i);
+    }
+
+    sink_value += dynarray_length(values);
+    dynarray_destroy(values);
+}
+
+static void micro_dynarray_length(size_t operations) {
+    int* values = dynarray_create_prealloc(int, 64);
+    for (int i = 0; i < 64; i++) {
+        dynarray_push(values, i);
+    }
+
+    size_t sum = 0;
+    for (size_t i = 0; i < operations; i++) {
+        sum += values[i % dynarray_length(values)];
+    }
+
+    sink_value += sum;
+    dynarray_destroy(values);
+}
+
+static void micro_dynarray_splice(size_t operations) {
+    int* values = dynarray_create_prealloc(int, 256);
+    for (int i = 0; i < 256; i++) {
+        dynarray_push(values, i);
+    }
+
+    // Removes and reinserts one element in the middle, so every call moves
+    // half the array twice.
+    int item = 0;
+    for (size_t i = 0; i < operations; i++) {
+        dynarray_splice(values, 128, 1, NULL, 0);
+        dynarray_splice(values, 128, 0, &item, 1);
+    }
+
+    sink_value += dynarray_length(values);
+    dynarray_destroy(values);
+}
+
+static const char* identifiers[] = {
+    "x", "count", "value", "parameter_1", "a_rather_long_identifier_name",
+    "int", "float", "bool", "void", "another_rather_long_identifier",
+};
+
+#define IDENTIFIER_COUNT (sizeof(identifiers) / sizeof(identifiers[0]))
+
+static void micro_sv_make_from(size_t operations) {
+    size_t size = 0;
+    for (size_t i = 0; i < operations; i++) {
+        size += sv_make_from(identifiers[i % IDENTIFIER_COUNT]).size;
+    }
+
+    sink_value += size;
+}
+
+// Compares against a copy so equal views do not share a pointer.
+static void micro_sv_equals(size_t operations) {
+    sv_t views[IDENTIFIER_COUNT];
+    sv_t copies[IDENTIFIER_COUNT];
+    char buffer[512];
+    size_t used = 0;
+
+    for (size_t i = 0; i < IDENTIFIER_COUNT; i++) {
+        views[i] = sv_make_from(identifiers[i]);
+        memcpy(buffer + used, views[i].data, views[i].size);
+        copies[i] = sv_make(buffer + used, views[i].size);
+        used += views[i].size;
+    }
+
+    size_t equal = 0;
+    for (size_t i = 0; i < operations; i++) {
+        equal += sv_equals(views[i % IDENTIFIER_COUNT], copies[(i / IDENTIFIER_COUNT + i) % IDENTIFIER_COUNT]);
+    }
+
+    sink_value += equal;
+}
+
+typedef struct {
+    const char* name;
+    void (*run)(size_t);
+} micro_t;
+
+static const micro_t micros[] = {
+    { "dynarray push", micro_dynarray_push },
+    { "  prealloc", micro_dynarray_push_prealloc },
+    { "dynarray length", micro_dynarray_length },
+    { "dynarray splice", micro_dynarray_splice },
+    { "sv_make_from", micro_sv_make_from },
+    { "sv_equals", micro_sv_equals },
+};
+
+#define MICRO_COUNT (sizeof(micros) / sizeof(micros[0]))
+
+static void bench_micros(int runs) {
+    printf("\n");
+    header("micro");
+
+    for (size_t i = 0; i < MICRO_COUNT; i++) {
+        sample_t sample = { 0 };
+
+        for (int run = 0; run <= runs; run++) {
+            double start = now();
+            micros[i].run(MICRO_OPERATIONS);
+            double seconds = now() - start;
+
+            if (run > 0) {
+                sample_add(&sample, seconds / MICRO_OPERATIONS * 1e9);
+            }
+        }
+
+        sample_print(micros[i].name, &sample, "ns/op");
+    }
+}
+
+static size_t lex_once(const char* data, size_t size, bool scalar) {
+    lexer_t lexer;
+    lexer_init(&lexer, data, size);
+    lexer.scalar = scalar;
+
+    token_buffer_t tokens;
+    token_buffer_init(&tokens);
+    get_tokens(&lexer, &tokens);
+
+    size_t count = token_buffer_length(&tokens);
+    token_buffer_deinit(&tokens);
+    lexer_deinit(&lexer);
+
+    return count;
+}
+
+static size_t lex_baseline(const char* data, size_t size) {
+    baseline_token_t* tokens = baseline_get_tokens(data, size);
+    size_t count = dynarray_length(tokens);
+    dynarray_destroy(tokens);
+
+    return count;
+}
+
+typedef enum {
+    LEXER_BASELINE,
+    LEXER_DFA_SCALAR,
+    LEXER_DFA,
+    LEXER_COUNT,
+} lexer_kind_t;
+
+static const char* lexer_names[LEXER_COUNT] = {
+    [LEXER_BASELINE]   = "switch",
+    [LEXER_DFA_SCALAR] = "dfa, scalar",
+    [LEXER_DFA]        = "dfa",
+};
+
+static size_t lex_with(lexer_kind_t kind, const char* data, size_t size) {
+    switch (kind) {
+        case LEXER_BASELINE:   return lex_baseline(data, size);
+        case LEXER_DFA_SCALAR: return lex_once(data, size, true);
+        default:               return lex_once(data, size, false);
+    }
+}
+
+// The switch lexer skips whitespace a byte at a time, so the scalar DFA row
+// isolates what the tables and keyword hash buy from what SIMD skipping does.
+static bool bench_lexers(const char* data, size_t size, int runs) {
+    sample_t samples[LEXER_COUNT] = { 0 };
+    size_t counts[LEXER_COUNT];
+
+    for (int run = 0; run <= runs; run++) {
+        for (int i = 0; i < LEXER_COUNT; i++) {
+            double start = now();
+            counts[i] = lex_with(i, data, size);
+            double seconds = now() - start;
+
+            if (run > 0) {
+                sample_add(&samples[i], counts[i] / seconds / 1e6);
+            }
+        }
+
+        if (counts[LEXER_BASELINE] != counts[LEXER_DFA] || counts[LEXER_DFA_SCALAR] != counts[LEXER_DFA]) {
+            fprintf(stderr, "ERROR: the lexers disagree on the token count\n");
+            return false;
+        }
+    }
+
+    printf("input: %zu bytes, %zu tokens, %d runs\n\n", size, counts[LEXER_DFA], runs);
+    header("lexer");
+    for (int i = 0; i < LEXER_COUNT; i++) {
+        sample_print(lexer_names[i], &samples[i], "Mtokens/s");
+    }
+
+    double baseline = sample_mean(&samples[LEXER_BASELINE]);
+    printf("\nspeedup over switch: %.2fx scalar, %.2fx with SIMD\n",
+           sample_mean(&samples[LEXER_DFA_SCALAR]) / baseline, sample_mean(&samples[LEXER_DFA]) / baseline);
+
+    return true;
+}
+
+// Lexes as a session would: serially on one thread, in parallel otherwise,
+// interning identifiers either way.
+static size_t lex_threads(const char* data, size_t size, int threads) {
+    interner_t interner;
+    interner_init(&interner);
+
+    lexer_t lexer;
+    lexer_init(&lexer, data, size);
+    lexer.interner = &interner;
+
+    token_buffer_t tokens;
+    token_buffer_init(&tokens);
+
+    if (threads > 1) {
+        get_tokens_parallel(&lexer, &tokens, threads);
+    } else {
+        get_tokens(&lexer, &tokens);
+    }
+
+    size_t count = token_buffer_length(&tokens);
+    token_buffer_deinit(&tokens);
+    lexer_deinit(&lexer);
+    interner_deinit(&interner);
+
+    return count;
+}
+
+static void bench_threads(const char* data, size_t size, int runs, uint32_t max_threads) {
+    sample_t* samples = calloc(max_threads, sizeof(sample_t));
+    size_t count = 0;
+
+    for (uint32_t threads = 1; threads <= max_threads; threads++) {
+        for (int run = 0; run <= runs; run++) {
+            double start = now();
+            count = lex_threads(data, size, threads);
+            double seconds = now() - start;
+
+            if (run > 0) {
+                sample_add(&samples[threads - 1], count / seconds / 1e6);
+            }
+        }
+    }
+
+    printf("input: %zu bytes, %zu tokens, %d runs\n\n", size, count, runs);
+    header("lex threads");
+    for (uint32_t threads = 1; threads <= max_threads; threads++) {
+        char name[32];
+        snprintf(name, sizeof(name), "%"PRIu32" (%.2fx)", threads, sample_mean(&samples[threads - 1]) / sample_mean(&samples[0]));
+        sample_print(name, &samples[threads - 1], "Mtokens/s");
+    }
+
+    free(samples);
+}
+
+static bool parse_count(const char* text, uint32_t* value) {
+    char* end;
+    unsigned long parsed = strtoul(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || parsed > UINT32_MAX) {
+        return false;
+    }
+
+    *value = parsed;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    generator_options_t options = generator_options_default();
+    uint32_t runs = 10;
+    uint32_t seed = options.seed;
+    const char* emit_path = NULL;
+    bool micro = true;
+    bool lexers = false;
+    uint32_t threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        bool ok = true;
+
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            ok = parse_count(argv[++i], &runs) && runs > 0;
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            ok = parse_count(argv[++i], &options.functions);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            ok = parse_count(argv[++i], &options.depth);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            ok = parse_count(argv[++i], &options.width) && options.width > 0;
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            ok = parse_count(argv[++i], &options.identifier_length);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            ok = parse_count(argv[++i], &options.lets);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            ok = parse_count(argv[++i], &options.comments);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            ok = parse_count(argv[++i], &seed);
+        } else if (strcmp(argv[i], "--emit") == 0 && i + 1 < argc) {
+            emit_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-micro") == 0) {
+            micro = false;
+        } else if (strcmp(argv[i], "--lexers") == 0) {
+            lexers = true;
+        } else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+            ok = parse_count(argv[++i], &threads) && threads > 0;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    options.seed = seed;
+    mem_init(false);
+
+    size_t size;
+    char* data = generate_program(&options, &size);
+
+    if (emit_path) {
+        FILE* file = fopen(emit_path, "w");
+        if (!file) {
+            fprintf(stderr, "ERROR: could not open %s\n", emit_path);
+            free(data);
+            return 1;
+        }
+
+        fwrite(data, 1, size, file);
+        fclose(file);
+    }
+
+    if (threads) {
+        bench_threads(data, size, runs, threads);
+        free(data);
+        return 0;
+    }
+
+    if (lexers) {
+        bool ok = bench_lexers(data, size, runs);
+        free(data);
+        return ok ? 0 : 1;
+    }
+
+    bool ok = bench_compiler(data, size, options.functions, runs);
+    free(data);
+
+    if (ok && micro) {
+        bench_micros(runs);
+    }
+
+    return ok ? 0 : 1;
+}
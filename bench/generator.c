@@ -0,0 +1,151 @@
+#include <generator.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    const generator_options_t* options;
+    FILE* output;
+    uint64_t state;
+
+    // Function being written and how many of its bindings are in scope.
+    uint32_t function;
+    uint32_t visible;
+} generator_t;
+
+static const char* operators[] = { "+", "-", "*" };
+
+#define OPERATOR_COUNT (sizeof(operators) / sizeof(operators[0]))
+
+// xorshift64*, seeded so that a zero seed still works.
+static uint64_t next_random(generator_t* generator) {
+    uint64_t x = generator->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    generator->state = x;
+
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static uint32_t random_below(generator_t* generator, uint32_t bound) {
+    return next_random(generator) % bound;
+}
+
+static void write_name(generator_t* generator, char prefix, uint32_t index) {
+    int written = fprintf(generator->output, "%c%"PRIu32, prefix, index);
+
+    for (uint32_t i = written; i < generator->options->identifier_length; i++) {
+        fputc('_', generator->output);
+    }
+}
+
+// Bindings are numbered across both blocks, after the two parameters.
+static void write_operand(generator_t* generator) {
+    uint32_t choice = random_below(generator, 8);
+
+    if (choice < 3) {
+        fprintf(generator->output, "%"PRIu32, random_below(generator, 1000));
+    } else if (choice == 3 && generator->options->functions > 1) {
+        fprintf(generator->output, "f%"PRIu32"(", random_below(generator, generator->options->functions));
+        write_name(generator, 'a', 0);
+        fprintf(generator->output, ", %"PRIu32")", random_below(generator, 100));
+    } else {
+        uint32_t binding = random_below(generator, generator->visible + 2);
+        if (binding < 2) {
+            write_name(generator, 'a', binding);
+        } else {
+            write_name(generator, 'v', binding - 2);
+        }
+    }
+}
+
+static void write_expression(generator_t* generator, uint32_t depth) {
+    if (depth == 0) {
+        write_operand(generator);
+        return;
+    }
+
+    for (uint32_t i = 0; i < generator->options->width; i++) {
+        if (i > 0) {
+            fprintf(generator->output, " %s ", operators[random_below(generator, OPERATOR_COUNT)]);
+        }
+
+        if (depth > 1) {
+            fputc('(', generator->output);
+            write_expression(generator, depth - 1);
+            fputc(')', generator->output);
+        } else {
+            write_operand(generator);
+        }
+    }
+}
+
+static void write_lets(generator_t* generator, const char* indent) {
+    for (uint32_t i = 0; i < generator->options->lets; i++) {
+        fprintf(generator->output, "%slet ", indent);
+        write_name(generator, 'v', generator->visible);
+        fprintf(generator->output, " = ");
+        write_expression(generator, generator->options->depth);
+        fprintf(generator->output, ";\n");
+
+        generator->visible++;
+    }
+}
+
+static void write_function(generator_t* generator) {
+    for (uint32_t i = 0; i < generator->options->comments; i++) {
+        fprintf(generator->output, "# Function %"PRIu32", note %"PRIu32": the quick brown fox jumps over the lazy dog.\n", generator->function, i);
+    }
+
+    fprintf(generator->output, "def f%"PRIu32"(", generator->function);
+    write_name(generator, 'a', 0);
+    fprintf(generator->output, ": int, ");
+    write_name(generator, 'a', 1);
+    fprintf(generator->output, ": int) : int {\n");
+
+    generator->visible = 0;
+    write_lets(generator, "    ");
+
+    // The inner block's bindings go out of scope before the return.
+    uint32_t outer = generator->visible;
+    fprintf(generator->output, "    {\n");
+    write_lets(generator, "        ");
+    fprintf(generator->output, "    }\n");
+    generator->visible = outer;
+
+    fprintf(generator->output, "    return ");
+    write_expression(generator, generator->options->depth);
+    fprintf(generator->output, ";\n}\n\n");
+}
+
+generator_options_t generator_options_default(void) {
+    return (generator_options_t) {
+        .functions = 1000,
+        .depth = 3,
+        .width = 3,
+        .identifier_length = 8,
+        .lets = 4,
+        .comments = 1,
+        .seed = 1,
+    };
+}
+
+char* generate_program(const generator_options_t* options, size_t* size) {
+    char* data = NULL;
+
+    generator_t generator = {
+        .options = options,
+        .output = open_memstream(&data, size),
+        .state = options->seed * 0x9E3779B97F4A7C15ULL + 1,
+    };
+
+    for (uint32_t i = 0; i < options->functions; i++) {
+        generator.function = i;
+        write_function(&generator);
+    }
+
+    fclose(generator.output);
+
+    return data;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The shape of a generated program. The same options and seed always give
+// the same bytes, so runs on different trees compare the same input.
+typedef struct {
+    uint32_t functions;
+
+    // Expressions nest `depth` levels of parentheses, each a chain of
+    // `width` operands.
+    uint32_t depth;
+    uint32_t width;
+
+    // Identifiers are padded with underscores up to this many bytes.
+    uint32_t identifier_length;
+
+    // Bindings per block; every function has an outer and an inner block.
+    uint32_t lets;
+
+    // Comment lines before each function.
+    uint32_t comments;
+
+    uint64_t seed;
+} generator_options_t;
+
+generator_options_t generator_options_default(void);
+
+// Returns a malloc'd program that type-checks, and its size.
+char* generate_program(const generator_options_t*, size_t*);
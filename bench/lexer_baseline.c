@@ -0,0 +1,173 @@
+#include <ctype.h>
+#include <dynarray/dynarray.h>
+#include <lexer_baseline.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    const char* input;
+    size_t size;
+    size_t cursor;
+    int64_t line;
+    int64_t col;
+} baseline_lexer_t;
+
+static char current(baseline_lexer_t* lexer) {
+    return lexer->input[lexer->cursor];
+}
+
+static bool is_eof(baseline_lexer_t* lexer) {
+    return lexer->cursor >= lexer->size;
+}
+
+static void advance(baseline_lexer_t* lexer) {
+    if (is_eof(lexer)) {
+        return;
+    }
+
+    if (current(lexer) == '\n') {
+        lexer->line++;
+        lexer->col = 1;
+    } else {
+        lexer->col++;
+    }
+
+    lexer->cursor++;
+}
+
+static void skip_ws_and_comments(baseline_lexer_t* lexer) {
+    while (!is_eof(lexer)) {
+        if (isspace(current(lexer))) {
+            advance(lexer);
+        } else if (current(lexer) == '#') {
+            while (!is_eof(lexer) && current(lexer) != '\n') {
+                advance(lexer);
+            }
+        } else {
+            break;
+        }
+    }
+}
+
+static baseline_token_t make(token_kind_t kind, sv_t span, int64_t line, int64_t col) {
+    return (baseline_token_t) { .kind = kind, .span = span, .location = location_make(line, col) };
+}
+
+// Punctuation that may be followed by '=' to form a second token.
+static bool lex_punctuation(baseline_lexer_t* lexer, baseline_token_t* token, int64_t line, int64_t col) {
+    switch (current(lexer)) {
+        case '(': advance(lexer); *token = make(TOK_LPAREN, sv_make_from("("), line, col); return true;
+        case ')': advance(lexer); *token = make(TOK_RPAREN, sv_make_from(")"), line, col); return true;
+        case '{': advance(lexer); *token = make(TOK_LCURLY, sv_make_from("{"), line, col); return true;
+        case '}': advance(lexer); *token = make(TOK_RCURLY, sv_make_from("}"), line, col); return true;
+        case ':': advance(lexer); *token = make(TOK_COLON, sv_make_from(":"), line, col); return true;
+        case ',': advance(lexer); *token = make(TOK_COMMA, sv_make_from(","), line, col); return true;
+        case ';': advance(lexer); *token = make(TOK_SEMICOLON, sv_make_from(";"), line, col); return true;
+        case '+': advance(lexer); *token = make(TOK_PLUS, sv_make_from("+"), line, col); return true;
+        case '-': advance(lexer); *token = make(TOK_MINUS, sv_make_from("-"), line, col); return true;
+        case '*': advance(lexer); *token = make(TOK_STAR, sv_make_from("*"), line, col); return true;
+        case '/': advance(lexer); *token = make(TOK_SLASH, sv_make_from("/"), line, col); return true;
+        case '<': advance(lexer); *token = make(TOK_LESS, sv_make_from("<"), line, col); return true;
+        case '>': advance(lexer); *token = make(TOK_GREATER, sv_make_from(">"), line, col); return true;
+        case '=':
+            advance(lexer);
+            if (!is_eof(lexer) && current(lexer) == '=') {
+                advance(lexer);
+                *token = make(TOK_EQUAL_EQUAL, sv_make_from("=="), line, col);
+                return true;
+            }
+            *token = make(TOK_EQUAL, sv_make_from("="), line, col);
+            return true;
+        case '!':
+            advance(lexer);
+            if (!is_eof(lexer) && current(lexer) == '=') {
+                advance(lexer);
+                *token = make(TOK_BANG_EQUAL, sv_make_from("!="), line, col);
+                return true;
+            }
+            *token = make(TOK_BANG, sv_make_from("!"), line, col);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static token_kind_t keyword_kind(sv_t span) {
+    if (sv_equals(span, sv_make_from("def"))) {
+        return TOK_DEF;
+    } else if (sv_equals(span, sv_make_from("let"))) {
+        return TOK_LET;
+    } else if (sv_equals(span, sv_make_from("return"))) {
+        return TOK_RETURN;
+    } else if (sv_equals(span, sv_make_from("or"))) {
+        return TOK_OR;
+    } else if (sv_equals(span, sv_make_from("and"))) {
+        return TOK_AND;
+    } else if (sv_equals(span, sv_make_from("true"))) {
+        return TOK_TRUE;
+    } else if (sv_equals(span, sv_make_from("false"))) {
+        return TOK_FALSE;
+    }
+
+    return TOK_IDENTIFIER;
+}
+
+baseline_token_t* baseline_get_tokens(const char* input, size_t size) {
+    baseline_lexer_t lexer = { .input = input, .size = size, .line = 1, .col = 1 };
+    baseline_token_t* tokens = dynarray_create(baseline_token_t);
+
+    while (true) {
+        skip_ws_and_comments(&lexer);
+
+        const char* start = &input[lexer.cursor];
+        const int64_t line = lexer.line;
+        const int64_t col = lexer.col;
+
+        if (is_eof(&lexer)) {
+            dynarray_push_rval(tokens, make(TOK_EOF, sv_make_from(""), line, col));
+            break;
+        }
+
+        baseline_token_t token;
+        if (lex_punctuation(&lexer, &token, line, col)) {
+            dynarray_push(tokens, token);
+            continue;
+        }
+
+        if (isdigit(current(&lexer))) {
+            token_kind_t kind = TOK_INTLITERAL;
+            do {
+                advance(&lexer);
+            } while (!is_eof(&lexer) && isdigit(current(&lexer)));
+
+            if (!is_eof(&lexer) && current(&lexer) == '.') {
+                advance(&lexer);
+                kind = isdigit(current(&lexer)) ? TOK_FLOATLITERAL : TOK_GARBAGE;
+                while (!is_eof(&lexer) && isdigit(current(&lexer))) {
+                    advance(&lexer);
+                }
+            }
+
+            dynarray_push_rval(tokens, make(kind, sv_make(start, &input[lexer.cursor] - start), line, col));
+            continue;
+        }
+
+        if (isalpha(current(&lexer)) || current(&lexer) == '_') {
+            do {
+                advance(&lexer);
+            } while (!is_eof(&lexer) && (isalnum(current(&lexer)) || current(&lexer) == '_'));
+
+            sv_t span = sv_make(start, &input[lexer.cursor] - start);
+            dynarray_push_rval(tokens, make(keyword_kind(span), span, line, col));
+            continue;
+        }
+
+        do {
+            advance(&lexer);
+        } while (!is_eof(&lexer) && !isspace(current(&lexer)));
+
+        dynarray_push_rval(tokens, make(TOK_GARBAGE, sv_make(start, &input[lexer.cursor] - start), line, col));
+    }
+
+    return tokens;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <common.h>
+#include <stddef.h>
+#include <sv/sv.h>
+#include <token.h>
+
+// The lexer the character-class DFA replaced: a switch over punctuation,
+// <ctype.h> classification and a chain of keyword comparisons, tracking
+// line and column per byte. It is kept only so the bench can compare the
+// two on the same input.
+typedef struct {
+    token_kind_t kind;
+    sv_t span;
+    location_t location;
+} baseline_token_t;
+
+// Returns a dynarray of tokens ending in TOK_EOF.
+baseline_token_t* baseline_get_tokens(const char*, size_t);
@@ -0,0 +1,154 @@
+#include <common.h>
+#include <fcntl.h>
+#include <protocol.h>
+#include <source.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Sends the same file to a running compile server over one connection and
+// reports throughput and latency. With --spawn it instead runs the given
+// compiler once per request, which is what the server replaces.
+
+extern char** environ;
+
+static void usage(const char* program) {
+    fprintf(stderr, "usage: %s [-n requests] [--socket path | --spawn compiler] <file>\n", program);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double lhs = *(const double*) a;
+    double rhs = *(const double*) b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static bool skip(int fd, uint64_t size) {
+    char buffer[1 << 16];
+
+    while (size > 0) {
+        size_t chunk = size < sizeof(buffer) ? size : sizeof(buffer);
+        if (!read_all(fd, buffer, chunk)) {
+            return false;
+        }
+
+        size -= chunk;
+    }
+
+    return true;
+}
+
+static bool request_server(int fd, source_t* source) {
+    request_header_t request = {
+        .magic = PROTOCOL_MAGIC,
+        .source_size = source->size,
+    };
+
+    reply_header_t reply;
+    return write_all(fd, &request, sizeof(request))
+        && write_all(fd, source->data, source->size)
+        && read_all(fd, &reply, sizeof(reply))
+        && skip(fd, reply.code_size + reply.diagnostics_size);
+}
+
+static bool request_spawn(const char* compiler, const char* filepath) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    char* args[] = { (char*) compiler, (char*) filepath, NULL };
+
+    pid_t pid;
+    int status = 0;
+    bool spawned = posix_spawn(&pid, compiler, &actions, NULL, args, environ) == 0;
+    if (spawned) {
+        waitpid(pid, &status, 0);
+    }
+
+    posix_spawn_file_actions_destroy(&actions);
+    return spawned && WIFEXITED(status);
+}
+
+int main(int argc, char** argv) {
+    const char* filepath = NULL;
+    const char* socket_path = NULL;
+    const char* compiler = NULL;
+    int requests = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            requests = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--spawn") == 0 && i + 1 < argc) {
+            compiler = argv[++i];
+        } else if (!filepath) {
+            filepath = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!filepath || requests < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    source_t source;
+    if (!source_open(&source, filepath)) {
+        return EXIT_FAILURE;
+    }
+
+    int fd = -1;
+    if (!compiler) {
+        fd = protocol_connect(protocol_socket_path(socket_path));
+        if (fd < 0) {
+            source_close(&source);
+            return EXIT_FAILURE;
+        }
+    }
+
+    double* latencies = malloc(sizeof(double) * requests);
+    double start = now();
+
+    for (int i = 0; i < requests; i++) {
+        double begin = now();
+        bool ok = compiler ? request_spawn(compiler, filepath) : request_server(fd, &source);
+        latencies[i] = now() - begin;
+
+        if (!ok) {
+            fprintf(stderr, "ERROR: request %d failed\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    double elapsed = now() - start;
+    qsort(latencies, requests, sizeof(double), compare_doubles);
+
+    printf("mode:         %s\n", compiler ? "spawn" : "server");
+    printf("requests:     %d\n", requests);
+    printf("requests/sec: %.1f\n", requests / elapsed);
+    printf("p50 latency:  %.1f us\n", latencies[requests / 2] * 1e6);
+    printf("p99 latency:  %.1f us\n", latencies[(int) (requests * 0.99)] * 1e6);
+
+    free(latencies);
+    if (fd >= 0) {
+        close(fd);
+    }
+    source_close(&source);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+struct arena_block_t {
+    arena_block_t* next;
+    size_t size;
+    size_t used;
+    alignas(ARENA_ALIGNMENT) unsigned char data[];
+};
+
+static void* (*arena_block_alloc)(size_t) = malloc;
+static void (*arena_block_dealloc)(void*) = free;
+
+void arena_set_allocator(void* (*alloc)(size_t), void (*dealloc)(void*)) {
+    arena_block_alloc = alloc;
+    arena_block_dealloc = dealloc;
+}
+
+static arena_block_t* arena_block_make(size_t size, arena_block_t* next) {
+    arena_block_t* block = arena_block_alloc(sizeof(arena_block_t) + size);
+    block->next = next;
+    block->size = size;
+    block->used = 0;
+
+    return block;
+}
+
+void arena_init(arena_t* arena) {
+    arena->blocks = NULL;
+    arena->block_size = ARENA_DEFAULT_BLOCK_SIZE;
+}
+
+void arena_deinit(arena_t* arena) {
+    arena_block_t* block = arena->blocks;
+    while (block) {
+        arena_block_t* next = block->next;
+        arena_block_dealloc(block);
+        block = next;
+    }
+
+    arena->blocks = NULL;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    arena_block_t* block = arena->blocks;
+    if (!block || block->size - block->used < size) {
+        if (size > arena->block_size / 4) {
+            // Big allocations get a block of their own behind the current
+            // one, so the space left in the current block is not wasted.
+            arena_block_t* own = arena_block_make(size, NULL);
+            own->used = size;
+
+            if (block) {
+                own->next = block->next;
+                block->next = own;
+            } else {
+                arena->blocks = own;
+            }
+
+            return own->data;
+        }
+
+        block = arena_block_make(arena->block_size, block);
+        arena->blocks = block;
+    }
+
+    void* memory = block->data + block->used;
+    block->used += size;
+
+    return memory;
+}
+
+void arena_reset(arena_t* arena) {
+    arena_block_t* block = arena->blocks;
+    if (!block) {
+        return;
+    }
+
+    // Keep the last block in the list; it is the oldest and, unless it was
+    // an oversized one, has the default size.
+    arena_block_t* keep = block;
+    while (keep->next) {
+        arena_block_t* next = keep->next;
+        arena_block_dealloc(keep);
+        keep = next;
+    }
+
+    keep->used = 0;
+    arena->blocks = keep;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+// A region allocator: allocations bump a pointer through large blocks and
+// are only ever released all at once.
+typedef struct arena_block_t arena_block_t;
+
+typedef struct {
+    arena_block_t* blocks;
+    size_t block_size;
+} arena_t;
+
+// Blocks of every arena are allocated and freed through these, which
+// default to malloc and free. Replace them before the first block is made.
+void arena_set_allocator(void* (*alloc)(size_t), void (*dealloc)(void*));
+
+void arena_init(arena_t* arena);
+void arena_deinit(arena_t* arena);
+
+void* arena_alloc(arena_t* arena, size_t size);
+
+// Releases every allocation but keeps the first block around for reuse.
+void arena_reset(arena_t* arena);
@@ -1,5 +1,7 @@
 #include "dynarray.h"
 
+#include <stdatomic.h>
+
 /*
 
 Dynamic Array
@@ -16,13 +18,35 @@ To set the ith element of the array, use either bracket notation
 (`arr[i] = x;`), or the `dynarray_set` method which does bounds checking.
 */
 
+static void *(*dynarray_alloc)(size_t) = malloc;
+static void (*dynarray_dealloc)(void *) = free;
+
+static atomic_size_t resizes;
+static atomic_size_t unused_bytes;
+
+void dynarray_set_allocator(void *(*alloc)(size_t), void (*dealloc)(void *))
+{
+    dynarray_alloc = alloc;
+    dynarray_dealloc = dealloc;
+}
+
+size_t dynarray_resize_count(void)
+{
+    return atomic_load_explicit(&resizes, memory_order_relaxed);
+}
+
+size_t dynarray_unused_bytes(void)
+{
+    return atomic_load_explicit(&unused_bytes, memory_order_relaxed);
+}
+
 // Returns a pointer to the start of a new dynarray (after the header) which
 // has `init_cap` units of `stride` bytes.
 void *_dynarray_create(size_t init_cap, size_t stride)
 {
     size_t header_size = DYNARRAY_FIELDS * sizeof(size_t);
     size_t arr_size = init_cap * stride;
-    size_t *arr = (size_t *) malloc(header_size + arr_size);
+    size_t *arr = (size_t *) dynarray_alloc(header_size + arr_size);
     arr[CAPACITY] = init_cap;
     arr[LENGTH] = 0;
     arr[STRIDE] = stride;
@@ -31,7 +55,15 @@ void *_dynarray_create(size_t init_cap, size_t stride)
 
 void _dynarray_destroy(void *arr)
 {
-    free(arr - DYNARRAY_FIELDS * sizeof(size_t));
+    size_t unused = (dynarray_capacity(arr) - dynarray_length(arr)) * dynarray_stride(arr);
+    atomic_fetch_add_explicit(&unused_bytes, unused, memory_order_relaxed);
+
+    dynarray_dealloc(arr - DYNARRAY_FIELDS * sizeof(size_t));
+}
+
+static void dynarray_free(void *arr)
+{
+    dynarray_dealloc(arr - DYNARRAY_FIELDS * sizeof(size_t));
 }
 
 // Returns the dynarray's field which is specified by passing
@@ -56,7 +88,8 @@ void *_dynarray_resize(void *arr)
     );
     memcpy(temp, arr, dynarray_length(arr) * dynarray_stride(arr)); // Copy erythin' over.
     _dynarray_field_set(temp, LENGTH, dynarray_length(arr)); // Set `length` field.
-    _dynarray_destroy(arr); // Free previous array.
+    dynarray_free(arr); // Free previous array.
+    atomic_fetch_add_explicit(&resizes, 1, memory_order_relaxed);
     return temp;
 }
 
@@ -77,4 +110,20 @@ void _dynarray_pop(void *arr, void *dest)
     _dynarray_field_set(arr, LENGTH, dynarray_length(arr) - 1); // Decrement length.
 }
 
+// Replaces `remove` elements starting at `index` with `count` elements copied
+// from `items`, shifting the rest of the array to fit.
+void *_dynarray_splice(void *arr, size_t index, size_t remove, const void *items, size_t count)
+{
+    size_t stride = dynarray_stride(arr);
+    size_t length = dynarray_length(arr);
+    size_t new_length = length - remove + count;
+
+    while (new_length > dynarray_capacity(arr))
+        arr = _dynarray_resize(arr);
 
+    if (count != remove)
+        memmove(arr + (index + count) * stride, arr + (index + remove) * stride, (length - index - remove) * stride);
+    memcpy(arr + index * stride, items, count * stride);
+    _dynarray_field_set(arr, LENGTH, new_length);
+    return arr;
+}
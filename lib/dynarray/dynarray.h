@@ -18,6 +18,16 @@ enum {
     DYNARRAY_FIELDS
 };
 
+// Every dynarray is allocated and freed through these, which default to
+// malloc and free. Replace them before the first dynarray is created.
+void dynarray_set_allocator(void *(*alloc)(size_t), void (*dealloc)(void *));
+
+// Counted over every dynarray since the program started: how many times one
+// grew, and the capacity, in bytes, that was still unused when one was
+// destroyed.
+size_t dynarray_resize_count(void);
+size_t dynarray_unused_bytes(void);
+
 void *_dynarray_create(size_t length, size_t stride);
 void _dynarray_destroy(void *arr);
 
@@ -28,6 +38,7 @@ void *_dynarray_resize(void *arr);
 
 void *_dynarray_push(void *arr, void *xptr);
 void _dynarray_pop(void *arr, void *dest);
+void *_dynarray_splice(void *arr, size_t index, size_t remove, const void *items, size_t count);
 
 #define DYNARRAY_DEFAULT_CAP 1
 #define DYNARRAY_RESIZE_FACTOR 2
@@ -44,6 +55,7 @@ void _dynarray_pop(void *arr, void *dest);
     } while (0)
 
 #define dynarray_pop(arr, xptr) _dynarray_pop(arr, xptr)
+#define dynarray_splice(arr, index, remove, items, count) arr = _dynarray_splice(arr, index, remove, items, count)
 
 #define dynarray_capacity(arr) _dynarray_field_get(arr, CAPACITY)
 #define dynarray_length(arr) _dynarray_field_get(arr, LENGTH)
@@ -1,6 +1,6 @@
 #include "sv.h"
 
-sv_t sv_make(const char* data, int size) {
+sv_t sv_make(const char* data, size_t size) {
     return (sv_t) {
         .data = data,
         .size = size,
@@ -8,7 +8,7 @@ sv_t sv_make(const char* data, int size) {
 }
 
 sv_t sv_make_from(const char* cstr) {
-    int size = 0;
+    size_t size = 0;
     while (cstr[size]) {
         size++;
     }
@@ -24,7 +24,7 @@ bool sv_equals(sv_t lhs, sv_t rhs) {
         return false;
     }
 
-    for (int i = 0; i < lhs.size; i++) {
+    for (size_t i = 0; i < lhs.size; i++) {
         if (lhs.data[i] != rhs.data[i]) {
             return false;
         }
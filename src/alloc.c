@@ -0,0 +1,147 @@
+#include <alloc.h>
+#include <arena/arena.h>
+#include <dynarray/dynarray.h>
+#include <inttypes.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Keeps the block after it aligned for any type.
+typedef struct {
+    alignas(max_align_t) uint64_t size;
+    uint32_t tag;
+} mem_header_t;
+
+typedef struct {
+    atomic_uint_fast64_t allocations;
+    atomic_uint_fast64_t bytes;
+    atomic_uint_fast64_t live;
+    atomic_uint_fast64_t peak;
+} mem_counters_t;
+
+static const char* tag_names[MEM_TAG_COUNT] = {
+    [MEM_OTHER]   = "other",
+    [MEM_LEXER]   = "lexer",
+    [MEM_AST]     = "ast",
+    [MEM_SYMBOLS] = "symbols",
+    [MEM_CODEGEN] = "codegen",
+    [MEM_OUTPUT]  = "output",
+};
+
+static bool counting = false;
+static mem_counters_t tags[MEM_TAG_COUNT];
+static atomic_uint_fast64_t live;
+static atomic_uint_fast64_t peak;
+
+static _Thread_local mem_tag_t current_tag = MEM_OTHER;
+
+void mem_init(bool stats) {
+    counting = stats;
+    dynarray_set_allocator(mem_alloc, mem_free);
+    arena_set_allocator(mem_alloc, mem_free);
+}
+
+mem_tag_t mem_set_tag(mem_tag_t tag) {
+    mem_tag_t previous = current_tag;
+    current_tag = tag;
+
+    return previous;
+}
+
+static void raise_peak(atomic_uint_fast64_t* peak, uint64_t value) {
+    uint64_t seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (seen < value && !atomic_compare_exchange_weak_explicit(peak, &seen, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void count_alloc(mem_tag_t tag, uint64_t size) {
+    mem_counters_t* counters = &tags[tag];
+
+    atomic_fetch_add_explicit(&counters->allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->bytes, size, memory_order_relaxed);
+    raise_peak(&counters->peak, atomic_fetch_add_explicit(&counters->live, size, memory_order_relaxed) + size);
+    raise_peak(&peak, atomic_fetch_add_explicit(&live, size, memory_order_relaxed) + size);
+}
+
+static void out_of_memory(size_t size) {
+    fprintf(stderr, "ERROR: out of memory allocating %zu bytes\n", size);
+    abort();
+}
+
+void* mem_alloc(size_t size) {
+    if (size > SIZE_MAX - sizeof(mem_header_t)) {
+        out_of_memory(size);
+    }
+
+    mem_header_t* header = malloc(sizeof(mem_header_t) + size);
+    if (!header) {
+        out_of_memory(size);
+    }
+
+    header->size = size;
+    header->tag = current_tag;
+
+    if (counting) {
+        count_alloc(header->tag, size);
+    }
+
+    return header + 1;
+}
+
+void* mem_calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        out_of_memory(SIZE_MAX);
+    }
+
+    void* memory = mem_alloc(count * size);
+    memset(memory, 0, count * size);
+
+    return memory;
+}
+
+// Frees are charged to the tag the block was allocated under.
+void mem_free(void* memory) {
+    if (!memory) {
+        return;
+    }
+
+    mem_header_t* header = (mem_header_t*) memory - 1;
+
+    if (counting) {
+        atomic_fetch_sub_explicit(&tags[header->tag].live, header->size, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&live, header->size, memory_order_relaxed);
+    }
+
+    free(header);
+}
+
+void mem_get_stats(mem_stats_t* stats) {
+    for (int i = 0; i < MEM_TAG_COUNT; i++) {
+        stats->tags[i] = (mem_usage_t) {
+            .allocations = atomic_load_explicit(&tags[i].allocations, memory_order_relaxed),
+            .bytes = atomic_load_explicit(&tags[i].bytes, memory_order_relaxed),
+            .live = atomic_load_explicit(&tags[i].live, memory_order_relaxed),
+            .peak = atomic_load_explicit(&tags[i].peak, memory_order_relaxed),
+        };
+    }
+
+    stats->live = atomic_load_explicit(&live, memory_order_relaxed);
+    stats->peak = atomic_load_explicit(&peak, memory_order_relaxed);
+    stats->dynarray_resizes = dynarray_resize_count();
+    stats->dynarray_unused_bytes = dynarray_unused_bytes();
+}
+
+void mem_stats_print(const mem_stats_t* stats, FILE* stream) {
+    fprintf(stream, "%-10s %12s %14s %14s %14s\n", "tag", "allocations", "bytes", "live bytes", "peak bytes");
+    for (int i = 0; i < MEM_TAG_COUNT; i++) {
+        const mem_usage_t* usage = &stats->tags[i];
+        fprintf(stream, "%-10s %12"PRIu64" %14"PRIu64" %14"PRIu64" %14"PRIu64"\n", tag_names[i], usage->allocations, usage->bytes, usage->live, usage->peak);
+    }
+
+    fprintf(stream, "\n");
+    fprintf(stream, "%-24s %14"PRIu64"\n", "peak live bytes", stats->peak);
+    fprintf(stream, "%-24s %14"PRIu64"\n", "dynarray resizes", stats->dynarray_resizes);
+    fprintf(stream, "%-24s %14"PRIu64"\n", "dynarray unused bytes", stats->dynarray_unused_bytes);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// What an allocation is for. Each thread has a current tag, set by the
+// subsystem it is running, and allocations are charged to it.
+typedef enum {
+    MEM_OTHER,
+    MEM_LEXER,
+    MEM_AST,
+    MEM_SYMBOLS,
+    MEM_CODEGEN,
+    MEM_OUTPUT,
+    MEM_TAG_COUNT,
+} mem_tag_t;
+
+typedef struct {
+    uint64_t allocations;
+    uint64_t bytes;
+    uint64_t live;
+    uint64_t peak;
+} mem_usage_t;
+
+typedef struct {
+    mem_usage_t tags[MEM_TAG_COUNT];
+
+    uint64_t live;
+    uint64_t peak;
+
+    uint64_t dynarray_resizes;
+    uint64_t dynarray_unused_bytes;
+} mem_stats_t;
+
+// Routes dynarray and arena allocations through mem_alloc. Must run before
+// anything is allocated; counting only starts once stats are enabled.
+void mem_init(bool);
+
+// Returns the tag it replaced, so callers can put it back.
+mem_tag_t mem_set_tag(mem_tag_t);
+
+// Every block carries its size and tag, so it must be freed with mem_free.
+// Running out of memory is reported and aborts.
+void* mem_alloc(size_t);
+void* mem_calloc(size_t, size_t);
+void mem_free(void*);
+
+void mem_get_stats(mem_stats_t*);
+void mem_stats_print(const mem_stats_t*, FILE*);
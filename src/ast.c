@@ -1,186 +1,63 @@
 #include <ast.h>
 #include <dynarray/dynarray.h>
-#include <stdlib.h>
 
-funcall_t* funcall_make(sv_t name, location_t location) {
-    funcall_t* funcall = malloc(sizeof(funcall_t));
-    funcall->name = name;
-    funcall->location = location;
-    funcall->arguments = dynarray_create(expression_t*);
-
-    return funcall;
-}
-
-void funcall_free(funcall_t* funcall) {
-    for (int i = 0; i < dynarray_length(funcall->arguments); i++) {
-        expression_free(funcall->arguments[i]);
-    }
-
-    dynarray_destroy(funcall->arguments);
-    free(funcall);
-}
-
-primary_t* primary_make(primary_kind_t kind, location_t location) {
-    primary_t* primary = malloc(sizeof(primary_t));
-    primary->kind = kind;
-    primary->location = location;
-
-    return primary;
-}
-
-void primary_free(primary_t* primary) {
-    switch (primary->kind) {
-        case PRIMARY_INTEGER:
-            break;
-        case PRIMARY_FLOATING:
-            break;
-        case PRIMARY_IDENTIFIER:
-            break;
-        case PRIMARY_BOOLEAN:
-            break;
-        case PRIMARY_FUNCALL:
-            funcall_free(primary->as.funcall);
-            break;
-    }
-
-    free(primary);
-}
-
-binary_t* binary_make(binary_op_t op, location_t location, expression_t* lhs, expression_t* rhs) {
-    binary_t* binary = malloc(sizeof(binary_t));
-    binary->op = op;
-    binary->location = location;
-    binary->lhs = lhs;
-    binary->rhs = rhs;
-    return binary;
+void ast_init(ast_t* ast, lexer_t* lexer) {
+    ast->lexer = lexer;
+    ast->nodes = dynarray_create(node_t);
+    ast->lists = dynarray_create(node_id_t);
 }
 
-void binary_free(binary_t* binary) {
-    expression_free(binary->lhs);
-    expression_free(binary->rhs);
-    free(binary);
+void ast_deinit(ast_t* ast) {
+    dynarray_destroy(ast->nodes);
+    dynarray_destroy(ast->lists);
 }
 
-expression_t* expression_make(expression_kind_t kind, location_t location) {
-    expression_t* expr = malloc(sizeof(expression_t));
-    expr->kind = kind;
-    expr->location = location;
-    return expr;
-}
-
-void expression_free(expression_t* expr) {
-    switch (expr->kind) {
-        case EXPR_PRIMARY:
-            primary_free(expr->as.primary);
-            break;
-        case EXPR_BINARY:
-            binary_free(expr->as.binary);
-            break;
-    }
-
-    free(expr);
-}
-
-block_t* block_make() {
-    block_t* block = malloc(sizeof(block_t));
-    block->statements = dynarray_create(statement_t*);
-    return block;
-}
-
-void block_free(block_t* block) {
-    for (int i = 0; i < dynarray_length(block->statements); i++) {
-        statement_free(block->statements[i]);
-    }
-
-    dynarray_destroy(block->statements);
-    free(block);
+node_t node_make(node_kind_t kind, uint64_t offset) {
+    return (node_t) {
+        .kind = kind,
+        .symbol = SYMBOL_NONE,
+        .offset = offset,
+    };
 }
 
-let_assignment_t* let_assignment_make(sv_t name, location_t location, expression_t* expr) {
-    let_assignment_t* let_assignment = malloc(sizeof(let_assignment_t));
-    let_assignment->name = name;
-    let_assignment->location = location;
-    let_assignment->expr = expr;
-
-    return let_assignment;
-}
+node_id_t ast_push(ast_t* ast, node_t node) {
+    node_id_t id = dynarray_length(ast->nodes);
+    dynarray_push(ast->nodes, node);
 
-void let_assignment_free(let_assignment_t* let_assignment) {
-    expression_free(let_assignment->expr);
-    free(let_assignment);
+    return id;
 }
 
-return_t* return_make(expression_t* expr, location_t location) {
-    return_t* ret = malloc(sizeof(return_t));
-    ret->expr = expr;
-    ret->location = location;
-    return ret;
-}
+node_range_t ast_push_list(ast_t* ast, const node_id_t* items, size_t count) {
+    node_range_t range = {
+        .first = dynarray_length(ast->lists),
+        .count = count,
+    };
 
-void return_free(return_t* ret) {
-    if (ret->expr) {
-        expression_free(ret->expr);
-    }
+    dynarray_splice(ast->lists, range.first, 0, items, count);
 
-    free(ret);
+    return range;
 }
 
-statement_t* statement_make(statement_kind_t kind, location_t location) {
-    statement_t* stmt = malloc(sizeof(statement_t));
-    stmt->kind = kind;
-    stmt->location = location;
-    return stmt;
+node_t* ast_node(ast_t* ast, node_id_t id) {
+    return &ast->nodes[id];
 }
 
-void statement_free(statement_t* stmt) {
-    switch (stmt->kind) {
-        case STMT_BLOCK:
-            block_free(stmt->as.block);
-            break;
-        case STMT_LET_ASSIGNMENT:
-            let_assignment_free(stmt->as.let_assignment);
-            break;
-        case STMT_RETURN:
-            return_free(stmt->as.ret);
-            break;
-    }
-
-    free(stmt);
+node_id_t ast_child(ast_t* ast, node_range_t range, uint32_t i) {
+    return ast->lists[range.first + i];
 }
 
-parameter_t parameter_make(sv_t name, sv_t type, location_t location) {
-    return (parameter_t) {
-        .name = name,
-        .type = type,
-        .location = location,
-    };
+sv_t ast_name(ast_t* ast, node_id_t id) {
+    return ast_symbol_name(ast, ast_node(ast, id)->symbol);
 }
 
-function_signature_t* function_signature_make(sv_t name, location_t location) {
-    function_signature_t* funsig = malloc(sizeof(function_signature_t));
-    funsig->name = name;
-    funsig->location = location;
-    funsig->parameters = dynarray_create(parameter_t);
-
-    return funsig;
+sv_t ast_symbol_name(ast_t* ast, symbol_t symbol) {
+    return interner_name(ast->lexer->interner, symbol);
 }
 
-void function_signature_free(function_signature_t* funsig) {
-    dynarray_destroy(funsig->parameters);
-    free(funsig);
-}
-
-function_definition_t* function_definition_make(function_signature_t* funsig, block_t* body, location_t location) {
-    function_definition_t* fundef = malloc(sizeof(function_definition_t));
-    fundef->funsig = funsig;
-    fundef->body = body;
-    fundef->location = location;
-
-    return fundef;
+location_t ast_location(ast_t* ast, node_id_t id) {
+    return lexer_location(ast->lexer, ast_node(ast, id)->offset);
 }
 
-void function_definition_free(function_definition_t* fundef) {
-    function_signature_free(fundef->funsig);
-    block_free(fundef->body);
-    free(fundef);
+node_id_t ast_function_first(ast_t* ast, node_id_t fundef) {
+    return ast_child(ast, ast_node(ast, fundef)->as.range, FUNCTION_NAME);
 }
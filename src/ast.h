@@ -1,43 +1,34 @@
 #pragma once
 
 #include <common.h>
-#include <sv/sv.h>
+#include <lexer.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <sv/sv.h>
 
-typedef struct expression_t expression_t;
+// The AST is a flat pool of fixed-size nodes addressed by 32-bit ids. The
+// parser creates children before their parents, so the pool holds every
+// function in post-order and the checker and emitter can walk it by id.
+typedef uint32_t node_id_t;
 
-typedef struct {
-    sv_t name;
-    location_t location;
-    expression_t** arguments;
-} funcall_t;
-
-funcall_t* funcall_make(sv_t, location_t);
-void funcall_free(funcall_t*);
+#define NODE_NONE UINT32_MAX
 
 typedef enum {
-    PRIMARY_INTEGER,
-    PRIMARY_FLOATING,
-    PRIMARY_IDENTIFIER,
-    PRIMARY_BOOLEAN,
-    PRIMARY_FUNCALL,
-} primary_kind_t;
-
-typedef struct {
-    primary_kind_t kind;
-    location_t location;
-
-    union {
-        int64_t integer;
-        double floating;
-        sv_t identifier;
-        bool boolean;
-        funcall_t* funcall;
-    } as;
-} primary_t;
-
-primary_t* primary_make(primary_kind_t, location_t);
-void primary_free(primary_t*);
+    NODE_NAME,        // A declared name or a type name; span is the name.
+    NODE_INTEGER,
+    NODE_FLOATING,
+    NODE_BOOLEAN,
+    NODE_IDENTIFIER,  // A variable reference; span is the name.
+    NODE_FUNCALL,     // span is the callee; range holds the arguments.
+    NODE_BINARY,      // pair is { lhs, rhs }.
+    NODE_BLOCK,       // range holds the statements.
+    NODE_LET_ASSIGNMENT,  // pair is { name, expression }.
+    NODE_RETURN,      // pair.lhs is the expression or NODE_NONE.
+    NODE_PARAMETER,   // span is the name; pair.lhs is the type name.
+    NODE_FUNCTION_DEFINITION,  // range is laid out as function_child_t.
+    NODE_TRANSLATION_UNIT,     // range holds the function definitions.
+    NODE_FOLDED,      // Removed by constant folding; nothing refers to it.
+} node_kind_t;
 
 typedef enum {
     BINARY_ADD,
@@ -55,104 +46,64 @@ typedef enum {
     BINARY_AND,
 } binary_op_t;
 
-typedef struct {
-    binary_op_t op;
-    location_t location;
-
-    expression_t* lhs;
-    expression_t* rhs;
-} binary_t;
-
-binary_t* binary_make(binary_op_t, location_t, expression_t*, expression_t*);
-void binary_free(binary_t*);
-
+// Children of a function definition, in order; the parameters follow.
 typedef enum {
-    EXPR_PRIMARY,
-    EXPR_BINARY,
-} expression_kind_t;
-
-struct expression_t {
-    expression_kind_t kind;
-    location_t location;
-
-    union {
-        primary_t* primary;
-        binary_t* binary;
-    } as;
-};
-
-expression_t* expression_make(expression_kind_t, location_t);
-void expression_free(expression_t*);
-
-typedef struct statement_t statement_t;
+    FUNCTION_NAME,
+    FUNCTION_RETURN_TYPE,
+    FUNCTION_BODY,
+    FUNCTION_PARAMETERS,
+} function_child_t;
 
 typedef struct {
-    statement_t** statements;
-} block_t;
-
-block_t* block_make();
-void block_free(block_t*);
+    uint32_t first;
+    uint32_t count;
+} node_range_t;
 
 typedef struct {
-    sv_t name;
-    location_t location;
-    expression_t* expr;
-} let_assignment_t;
+    uint8_t kind;
+    uint8_t op;
 
-let_assignment_t* let_assignment_make(sv_t, location_t, expression_t*);
-void let_assignment_free(let_assignment_t*);
+    // The interned name of names, identifiers, calls and parameters.
+    symbol_t symbol;
 
-typedef struct {
-    expression_t* expr;
-    location_t location;
-} return_t;
-
-return_t* return_make(expression_t*, location_t);
-void return_free(return_t*);
+    // The node's first source byte, which is also its location.
+    uint64_t offset;
 
-typedef enum {
-    STMT_BLOCK,
-    STMT_LET_ASSIGNMENT,
-    STMT_RETURN,
-} statement_kind_t;
+    union {
+        int64_t integer;
+        double floating;
+        bool boolean;
 
-struct statement_t {
-    statement_kind_t kind;
-    location_t location;
+        struct {
+            node_id_t lhs;
+            node_id_t rhs;
+        } pair;
 
-    union {
-        block_t* block;
-        let_assignment_t* let_assignment;
-        return_t* ret;
+        node_range_t range;
     } as;
-};
-
-statement_t* statement_make(statement_kind_t, location_t);
-void statement_free(statement_t*);
+} node_t;
 
 typedef struct {
-    sv_t name;
-    sv_t type;
-    location_t location;
-} parameter_t;
+    lexer_t* lexer;
 
-parameter_t parameter_make(sv_t, sv_t, location_t);
+    node_t* nodes;
+    node_id_t* lists;
+} ast_t;
 
-typedef struct {
-    location_t location;
-    sv_t name;
-    parameter_t* parameters;
-    sv_t return_type;
-} function_signature_t;
+void ast_init(ast_t*, lexer_t*);
+void ast_deinit(ast_t*);
 
-function_signature_t* function_signature_make(sv_t, location_t);
-void function_signature_free(function_signature_t*);
+node_t node_make(node_kind_t, uint64_t);
 
-typedef struct {
-    function_signature_t* funsig;
-    block_t* body;
-    location_t location;
-} function_definition_t;
+node_id_t ast_push(ast_t*, node_t);
+node_range_t ast_push_list(ast_t*, const node_id_t*, size_t);
+
+node_t* ast_node(ast_t*, node_id_t);
+node_id_t ast_child(ast_t*, node_range_t, uint32_t);
+
+sv_t ast_name(ast_t*, node_id_t);
+sv_t ast_symbol_name(ast_t*, symbol_t);
+location_t ast_location(ast_t*, node_id_t);
 
-function_definition_t* function_definition_make(function_signature_t*, block_t*, location_t);
-void function_definition_free(function_definition_t*);
+// The first node of a function's subtree, so [first, fundef] is the function.
+node_id_t ast_function_first(ast_t*, node_id_t);
@@ -0,0 +1,450 @@
+#include <alloc.h>
+#include <cache.h>
+#include <common.h>
+#include <dynarray/dynarray.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bumped whenever the emitted code or the key changes, which invalidates
+// every existing entry.
+#define COMPILE_CACHE_VERSION 4
+
+#define COMPILE_CACHE_MAGIC "DUKCACHE"
+#define COMPILE_CACHE_PACK "functions.pack"
+
+// Entries that were not used by the run that rewrites the pack are dropped
+// once it holds this much code.
+#define COMPILE_CACHE_MAX_CODE (64 << 20)
+
+// A pack is this header, `count` entries sorted by key and then the code,
+// with entry offsets relative to the start of the code.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+} cache_header_t;
+
+// FNV-1a for the hash, and a multiply and xor-shift mix for the check.
+static void hash_bytes(cache_key_t* key, const void* data, size_t size) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        key->hash ^= bytes[i];
+        key->hash *= 1099511628211u;
+
+        key->check = (key->check ^ bytes[i]) * 0x9E3779B97F4A7C15u;
+        key->check ^= key->check >> 32;
+    }
+}
+
+static void hash_u64(cache_key_t* key, uint64_t value) {
+    hash_bytes(key, &value, sizeof(value));
+}
+
+// Names are hashed by their text, since symbol ids depend on the order
+// identifiers were first seen in.
+static void hash_symbol(cache_key_t* key, ast_t* ast, symbol_t symbol) {
+    if (symbol == SYMBOL_NONE) {
+        hash_u64(key, UINT64_MAX);
+        return;
+    }
+
+    sv_t name = ast_symbol_name(ast, symbol);
+    hash_u64(key, name.size);
+    hash_bytes(key, name.data, name.size);
+}
+
+static void hash_type(cache_key_t* key, compiler_t* compiler, ast_t* ast, type_id_t type) {
+    hash_symbol(key, ast, type_info(compiler->types, type)->name);
+}
+
+// Child references are hashed relative to the function, so a function keeps
+// its key wherever it sits in the file.
+static void hash_child(cache_key_t* key, node_id_t first, node_id_t child) {
+    hash_u64(key, child == NODE_NONE ? UINT64_MAX : child - first);
+}
+
+static void hash_callee(cache_key_t* key, compiler_t* compiler, ast_t* ast, symbol_t name) {
+    compiled_function_t* fun = find_function(compiler, name);
+    if (!fun) {
+        hash_u64(key, UINT64_MAX);
+        return;
+    }
+
+    hash_type(key, compiler, ast, fun->return_type);
+    hash_u64(key, dynarray_length(fun->parameters));
+    for (size_t i = 0; i < dynarray_length(fun->parameters); i++) {
+        hash_type(key, compiler, ast, fun->parameters[i].type);
+    }
+}
+
+// Offsets are left out: they only show up in diagnostics, and functions with
+// diagnostics are never cached.
+cache_key_t compile_cache_key(compiler_t* compiler, ast_t* ast, node_id_t fundef) {
+    node_id_t first = ast_function_first(ast, fundef);
+    cache_key_t key = { .hash = 14695981039346656037u, .check = 0 };
+    hash_u64(&key, COMPILE_CACHE_VERSION);
+
+    for (node_id_t id = first; id <= fundef; id++) {
+        node_t* node = ast_node(ast, id);
+
+        hash_u64(&key, node->kind);
+        hash_u64(&key, node->op);
+        hash_symbol(&key, ast, node->symbol);
+
+        switch (node->kind) {
+            case NODE_INTEGER:
+                hash_u64(&key, node->as.integer);
+                break;
+            case NODE_FLOATING:
+                hash_bytes(&key, &node->as.floating, sizeof(node->as.floating));
+                break;
+            case NODE_BOOLEAN:
+                hash_u64(&key, node->as.boolean);
+                break;
+            case NODE_BINARY:
+            case NODE_LET_ASSIGNMENT:
+            case NODE_RETURN:
+            case NODE_PARAMETER:
+                hash_child(&key, first, node->as.pair.lhs);
+                hash_child(&key, first, node->as.pair.rhs);
+                break;
+            case NODE_FUNCALL:
+                hash_callee(&key, compiler, ast, node->symbol);
+                // fallthrough
+            case NODE_BLOCK:
+            case NODE_FUNCTION_DEFINITION:
+                hash_u64(&key, node->as.range.count);
+                for (uint32_t i = 0; i < node->as.range.count; i++) {
+                    hash_child(&key, first, ast_child(ast, node->as.range, i));
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return key;
+}
+
+static bool same_key(cache_key_t a, cache_key_t b) {
+    return a.hash == b.hash && a.check == b.check;
+}
+
+static void pack_path(compile_cache_t* cache, char* path, size_t size) {
+    snprintf(path, size, "%s/"COMPILE_CACHE_PACK, cache->dir);
+}
+
+// A pack that is missing, truncated or from another version is treated as
+// empty.
+static void map_pack(compile_cache_t* cache) {
+    char path[4096];
+    pack_path(cache, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(cache_header_t)) {
+        close(fd);
+        return;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return;
+    }
+
+    const cache_header_t* header = data;
+    size_t table_end = sizeof(cache_header_t) + header->count * sizeof(cache_entry_t);
+
+    bool valid = memcmp(header->magic, COMPILE_CACHE_MAGIC, sizeof(header->magic)) == 0
+        && header->version == COMPILE_CACHE_VERSION
+        && header->count <= (st.st_size - sizeof(cache_header_t)) / sizeof(cache_entry_t);
+
+    const cache_entry_t* entries = (const cache_entry_t*) (header + 1);
+    for (size_t i = 0; valid && i < header->count; i++) {
+        valid = entries[i].offset <= st.st_size - table_end && entries[i].size <= st.st_size - table_end - entries[i].offset;
+    }
+
+    if (!valid) {
+        munmap(data, st.st_size);
+        return;
+    }
+
+    cache->data = data;
+    cache->size = st.st_size;
+    cache->entries = entries;
+    cache->count = header->count;
+}
+
+void compile_cache_open(compile_cache_t* cache, const char* dir) {
+    cache->dir = dir;
+    cache->data = NULL;
+    cache->size = 0;
+    cache->entries = NULL;
+    cache->count = 0;
+
+    map_pack(cache);
+    cache->used = mem_calloc(cache->count ? cache->count : 1, sizeof(atomic_bool));
+
+    pthread_mutex_init(&cache->lock, NULL);
+    arena_init(&cache->arena);
+    cache->fresh = dynarray_create(cache_entry_t);
+    cache->fresh_code = dynarray_create(char*);
+    cache->fresh_capacity = 0;
+    cache->fresh_slots = NULL;
+
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->misses, 0);
+}
+
+static const char* pack_code(compile_cache_t* cache) {
+    return (const char*) (cache->entries + cache->count);
+}
+
+// Entries whose hashes collide sit next to each other and are told apart
+// by their checks.
+static const cache_entry_t* find_entry(compile_cache_t* cache, cache_key_t key) {
+    size_t low = 0;
+    size_t high = cache->count;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (cache->entries[mid].key.hash < key.hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    for (; low < cache->count && cache->entries[low].key.hash == key.hash; low++) {
+        if (cache->entries[low].key.check == key.check) {
+            return &cache->entries[low];
+        }
+    }
+
+    return NULL;
+}
+
+// Returns the slot holding the fresh entry with `key`, or the empty slot
+// where it would go. The table is kept at most half full.
+static size_t find_fresh_slot(compile_cache_t* cache, cache_key_t key) {
+    size_t mask = cache->fresh_capacity - 1;
+    size_t slot = key.hash & mask;
+
+    while (cache->fresh_slots[slot] != UINT32_MAX && !same_key(cache->fresh[cache->fresh_slots[slot]].key, key)) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void grow_fresh(compile_cache_t* cache) {
+    size_t count = dynarray_length(cache->fresh);
+
+    cache->fresh_capacity = cache->fresh_capacity ? cache->fresh_capacity * 2 : 1024;
+    mem_free(cache->fresh_slots);
+    cache->fresh_slots = mem_alloc(sizeof(uint32_t) * cache->fresh_capacity);
+    memset(cache->fresh_slots, 0xFF, sizeof(uint32_t) * cache->fresh_capacity);
+
+    for (size_t i = 0; i < count; i++) {
+        cache->fresh_slots[find_fresh_slot(cache, cache->fresh[i].key)] = i;
+    }
+}
+
+static bool load_fresh(compile_cache_t* cache, cache_key_t key, emitter_t* output) {
+    pthread_mutex_lock(&cache->lock);
+
+    const char* code = NULL;
+    size_t size = 0;
+
+    if (cache->fresh_capacity > 0) {
+        uint32_t index = cache->fresh_slots[find_fresh_slot(cache, key)];
+        if (index != UINT32_MAX) {
+            code = cache->fresh_code[index];
+            size = cache->fresh[index].size;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    // Fresh code lives in the arena, which only grows while the cache is
+    // open.
+    if (code) {
+        emit_bytes(output, code, size);
+    }
+
+    return code != NULL;
+}
+
+bool compile_cache_load(compile_cache_t* cache, cache_key_t key, emitter_t* output) {
+    const cache_entry_t* entry = find_entry(cache, key);
+
+    if (entry) {
+        emit_bytes(output, pack_code(cache) + entry->offset, entry->size);
+        atomic_store_explicit(&cache->used[entry - cache->entries], true, memory_order_relaxed);
+    }
+
+    bool hit = entry || load_fresh(cache, key, output);
+    atomic_fetch_add(hit ? &cache->hits : &cache->misses, 1);
+
+    return hit;
+}
+
+void compile_cache_store(compile_cache_t* cache, cache_key_t key, const char* code, size_t size) {
+    pthread_mutex_lock(&cache->lock);
+
+    if (2 * (dynarray_length(cache->fresh) + 1) > cache->fresh_capacity) {
+        grow_fresh(cache);
+    }
+
+    // Two workers may have compiled the same function.
+    size_t slot = find_fresh_slot(cache, key);
+    if (cache->fresh_slots[slot] == UINT32_MAX) {
+        char* copy = arena_alloc(&cache->arena, size ? size : 1);
+        memcpy(copy, code, size);
+
+        cache->fresh_slots[slot] = dynarray_length(cache->fresh);
+
+        cache_entry_t entry = { .key = key, .size = size };
+        dynarray_push(cache->fresh, entry);
+        dynarray_push(cache->fresh_code, copy);
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Where a kept entry's code comes from while the pack is rewritten.
+typedef struct {
+    cache_entry_t entry;
+    const char* code;
+} kept_entry_t;
+
+static int compare_kept(const void* a, const void* b) {
+    cache_key_t lhs = ((const kept_entry_t*) a)->entry.key;
+    cache_key_t rhs = ((const kept_entry_t*) b)->entry.key;
+
+    if (lhs.hash != rhs.hash) {
+        return (lhs.hash > rhs.hash) - (lhs.hash < rhs.hash);
+    }
+
+    return (lhs.check > rhs.check) - (lhs.check < rhs.check);
+}
+
+// Entries are kept in order of preference: the ones added by this run, the
+// ones it used, then the rest while they fit. The new pack is written next
+// to the old one and renamed over it, so readers never see a partial pack.
+static void write_pack(compile_cache_t* cache) {
+    size_t fresh_count = dynarray_length(cache->fresh);
+    kept_entry_t* kept = mem_alloc(sizeof(kept_entry_t) * (fresh_count + cache->count));
+    size_t count = 0;
+    uint64_t code_size = 0;
+
+    for (size_t i = 0; i < fresh_count; i++) {
+        kept[count++] = (kept_entry_t) { cache->fresh[i], cache->fresh_code[i] };
+        code_size += cache->fresh[i].size;
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < cache->count; i++) {
+            bool used = atomic_load_explicit(&cache->used[i], memory_order_relaxed);
+            if (used != (pass == 0) || (!used && code_size + cache->entries[i].size > COMPILE_CACHE_MAX_CODE)) {
+                continue;
+            }
+
+            kept[count++] = (kept_entry_t) { cache->entries[i], pack_code(cache) + cache->entries[i].offset };
+            code_size += cache->entries[i].size;
+        }
+    }
+
+    qsort(kept, count, sizeof(kept_entry_t), compare_kept);
+
+    // Fresh entries were stored after missing the pack, so every key is
+    // kept once.
+    uint64_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        kept[i].entry.offset = offset;
+        offset += kept[i].entry.size;
+    }
+
+    char path[4096];
+    char temp[4096 + 64];
+    pack_path(cache, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s.%ld.tmp", path, (long) getpid());
+
+    mkdir(cache->dir, 0777);
+
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        mem_free(kept);
+        return;
+    }
+
+    cache_header_t header = {
+        .magic = COMPILE_CACHE_MAGIC,
+        .version = COMPILE_CACHE_VERSION,
+        .count = count,
+    };
+
+    cache_entry_t* table = mem_alloc(sizeof(cache_entry_t) * (count ? count : 1));
+    for (size_t i = 0; i < count; i++) {
+        table[i] = kept[i].entry;
+    }
+
+    bool written = write_all(fd, &header, sizeof(header)) && write_all(fd, table, sizeof(cache_entry_t) * count);
+    for (size_t i = 0; written && i < count; i++) {
+        written = write_all(fd, kept[i].code, kept[i].entry.size);
+    }
+
+    close(fd);
+
+    if (!written || rename(temp, path) != 0) {
+        unlink(temp);
+    }
+
+    mem_free(table);
+    mem_free(kept);
+}
+
+void compile_cache_close(compile_cache_t* cache) {
+    if (dynarray_length(cache->fresh) > 0) {
+        write_pack(cache);
+    }
+
+    if (cache->data) {
+        munmap((void*) cache->data, cache->size);
+    }
+
+    mem_free(cache->used);
+    mem_free(cache->fresh_slots);
+    dynarray_destroy(cache->fresh);
+    dynarray_destroy(cache->fresh_code);
+    arena_deinit(&cache->arena);
+    pthread_mutex_destroy(&cache->lock);
+}
+
+void compile_cache_flush(compile_cache_t* cache) {
+    if (dynarray_length(cache->fresh) == 0) {
+        return;
+    }
+
+    size_t hits = atomic_load(&cache->hits);
+    size_t misses = atomic_load(&cache->misses);
+
+    const char* dir = cache->dir;
+    compile_cache_close(cache);
+    compile_cache_open(cache, dir);
+
+    atomic_store(&cache->hits, hits);
+    atomic_store(&cache->misses, misses);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <arena/arena.h>
+#include <ast.h>
+#include <compiler.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Two hashes of the same input taken with different functions. Entries
+// are found by `hash`, and only used if `check` matches too.
+typedef struct {
+    uint64_t hash;
+    uint64_t check;
+} cache_key_t;
+
+// One cached function: its key and where its code is in the pack, or in
+// the arena for entries added by this run.
+typedef struct {
+    cache_key_t key;
+    uint64_t offset;
+    uint64_t size;
+} cache_entry_t;
+
+// Emitted assembly of functions that compiled, keyed by a hash of the
+// function's nodes and the signatures of the functions it calls. Entries
+// live in a single pack file in `dir` whose entry table is sorted by key,
+// so the pack is mapped once and searched in place.
+//
+// Lookups in the pack only read the mapping. Entries stored while compiling
+// are kept in memory, found through `fresh_slots` under the lock, and
+// written out with the pack on close, most recently used first.
+typedef struct {
+    const char* dir;
+
+    const char* data;
+    size_t size;
+    const cache_entry_t* entries;
+    size_t count;
+    atomic_bool* used;
+
+    pthread_mutex_t lock;
+    arena_t arena;
+    cache_entry_t* fresh;
+    char** fresh_code;
+    uint32_t* fresh_slots;
+    size_t fresh_capacity;
+
+    atomic_size_t hits;
+    atomic_size_t misses;
+} compile_cache_t;
+
+void compile_cache_open(compile_cache_t*, const char*);
+
+// Writes the pack if this run added entries. Failing to write it is not an
+// error; the functions are just compiled again next time.
+void compile_cache_close(compile_cache_t*);
+
+// Writes the pack if this run added entries and maps the new one, so the
+// fresh entries' memory is given back. Must not run during a compile.
+void compile_cache_flush(compile_cache_t*);
+
+// Must be called before the body is checked, which may rewrite its nodes.
+cache_key_t compile_cache_key(compiler_t*, ast_t*, node_id_t);
+
+// Copies the entry's code to `output` and returns true on a hit.
+bool compile_cache_load(compile_cache_t*, cache_key_t, emitter_t*);
+void compile_cache_store(compile_cache_t*, cache_key_t, const char*, size_t);
@@ -0,0 +1,148 @@
+#include <common.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <protocol.h>
+#include <source.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Sends a file to a running `duktape --server` and prints the reply as the
+// compiler itself would, so it can stand in for `duktape <file>`.
+
+static void usage(const char* program) {
+    fprintf(stderr, "usage: %s [-j threads] [--emit=asm|obj|exe] [-o output] [--socket path] <file>\n", program);
+}
+
+// The reply is copied through in chunks so the client never holds it all.
+static bool forward(int fd, uint64_t size, FILE* stream) {
+    char buffer[1 << 16];
+
+    while (size > 0) {
+        size_t chunk = size < sizeof(buffer) ? size : sizeof(buffer);
+        if (!read_all(fd, buffer, chunk)) {
+            return false;
+        }
+
+        fwrite(buffer, 1, chunk, stream);
+        size -= chunk;
+    }
+
+    return true;
+}
+
+// Only an explicit --emit=exe creates the file executable, since the client
+// does not know what the server emits by default.
+static FILE* open_output(const char* path, bool executable) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, executable ? 0755 : 0644);
+    FILE* stream = fd >= 0 ? fdopen(fd, "w") : NULL;
+
+    if (!stream) {
+        fprintf(stderr, "ERROR: cannot open '%s': %s\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    return stream;
+}
+
+int main(int argc, char** argv) {
+    const char* filepath = NULL;
+    const char* output_path = NULL;
+    const char* socket_path = NULL;
+    protocol_emit_t emit = PROTOCOL_EMIT_DEFAULT;
+
+    for (int i = 1; i < argc; i++) {
+        // The server's thread count is fixed when it starts; -j is accepted
+        // so the client takes the compiler's command line.
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            i++;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "--emit=asm") == 0) {
+            emit = PROTOCOL_EMIT_ASSEMBLY;
+        } else if (strcmp(argv[i], "--emit=obj") == 0) {
+            emit = PROTOCOL_EMIT_OBJECT;
+        } else if (strcmp(argv[i], "--emit=exe") == 0) {
+            emit = PROTOCOL_EMIT_EXECUTABLE;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            // The program would run in the server's process.
+            fprintf(stderr, "ERROR: --run is not supported through the compile server\n");
+            return 1;
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (!filepath) {
+            filepath = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!filepath) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    source_t source;
+    if (!source_open(&source, filepath)) {
+        return EXIT_FAILURE;
+    }
+
+    if (source.size > PROTOCOL_MAX_SOURCE_SIZE) {
+        fprintf(stderr, "ERROR: '%s' is larger than the server accepts\n", filepath);
+        source_close(&source);
+        return EXIT_FAILURE;
+    }
+
+    int fd = protocol_connect(protocol_socket_path(socket_path));
+    if (fd < 0) {
+        source_close(&source);
+        return EXIT_FAILURE;
+    }
+
+    request_header_t request = {
+        .magic = PROTOCOL_MAGIC,
+        .emit = emit,
+        .source_size = source.size,
+    };
+
+    reply_header_t reply;
+    bool ok = write_all(fd, &request, sizeof(request))
+        && write_all(fd, source.data, source.size)
+        && read_all(fd, &reply, sizeof(reply))
+        && reply.magic == PROTOCOL_MAGIC;
+
+    source_close(&source);
+
+    // As with the compiler, the output file is only created once the
+    // program has compiled.
+    FILE* output = stdout;
+    if (ok && reply.compiled && output_path) {
+        output = open_output(output_path, emit == PROTOCOL_EMIT_EXECUTABLE);
+        if (!output) {
+            close(fd);
+            return EXIT_FAILURE;
+        }
+    }
+
+    ok = ok
+        && forward(fd, reply.code_size, output)
+        && forward(fd, reply.diagnostics_size, stderr);
+
+    close(fd);
+
+    if (output != stdout && fclose(output) != 0 && ok) {
+        fprintf(stderr, "ERROR: cannot write '%s': %s\n", output_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "ERROR: lost connection to the compile server\n");
+        return EXIT_FAILURE;
+    }
+
+    return reply.compiled ? EXIT_SUCCESS : EXIT_FAILURE;
+}
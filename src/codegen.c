@@ -1,137 +1,388 @@
 #include <assert.h>
 #include <codegen.h>
 #include <dynarray/dynarray.h>
+#include <regalloc.h>
 #include <stdio.h>
 
-static bool is_primary(expression_t* expr) {
-    return expr->kind == EXPR_PRIMARY;
-}
-
-static const char* reg_to_str(reg_t reg) {
-    switch (reg) {
-        case REG_RAX:
-            return "rax";
-        case REG_RBX:
-            return "rbx";
-        case REG_RCX:
-            return "rcx";
-        case REG_RDX:
-            return "rdx";
-        case REG_RDI:
-            return "rdi";
-        case REG_RSI:
-            return "rsi";
-        case REG_RBP:
-            return "rbp";
-        case REG_RSP:
-            return "rsp";
-        default:
-            return "";
+static const x86_alu_t binop_instructions[] = {
+    [BINARY_ADD] = X86_ADD,
+    [BINARY_SUB] = X86_SUB,
+    [BINARY_MUL] = X86_IMUL,
+    [BINARY_OR]  = X86_OR,
+    [BINARY_AND] = X86_AND,
+};
+
+static const x86_condition_t binop_conditions[] = {
+    [BINARY_EQUAL]         = X86_EQUAL,
+    [BINARY_NOT_EQUAL]     = X86_NOT_EQUAL,
+    [BINARY_LESS]          = X86_LESS,
+    [BINARY_GREATER]       = X86_GREATER,
+    [BINARY_LESS_EQUAL]    = X86_LESS_EQUAL,
+    [BINARY_GREATER_EQUAL] = X86_GREATER_EQUAL,
+};
+
+static x86_memory_t frame_slot(int offset) {
+    return (x86_memory_t) { .base = REG_RBP, .displacement = -offset };
+}
+
+static x86_memory_t stack_slot(int offset) {
+    return (x86_memory_t) { .base = REG_RSP, .displacement = offset };
+}
+
+// The temporary at `depth` shares its register with every temp_count-th one
+// below it, and has a stack slot to wait in while a deeper one holds it.
+static reg_t temp_reg(compiler_t* compiler, int depth) {
+    return temp_regs[depth % compiler->registers.temp_count];
+}
+
+static int spill_slot(compiler_t* compiler, int depth) {
+    return compiler->registers.spill_offset + 8 * (depth + 1);
+}
+
+// Returns the register of a new temporary on top of the expression stack,
+// spilling the one that held it.
+static reg_t push_temp(compiler_t* compiler) {
+    register_allocation_t* registers = &compiler->registers;
+    int depth = registers->temp_depth++;
+    reg_t reg = temp_reg(compiler, depth);
+
+    if (depth >= registers->temp_count) {
+        x86_store(&compiler->x86, frame_slot(spill_slot(compiler, depth - registers->temp_count)), reg);
     }
+
+    return reg;
 }
 
-static void mov_reg_to_reg(compiler_t* compiler, reg_t dst, reg_t src) {
-    printf("mov %s, %s\n", reg_to_str(dst), reg_to_str(src));
+// Drops the top temporary and reloads the one waiting for its register.
+static void pop_temp(compiler_t* compiler) {
+    register_allocation_t* registers = &compiler->registers;
+    int depth = --registers->temp_depth;
+
+    if (depth >= registers->temp_count) {
+        x86_load(&compiler->x86, temp_reg(compiler, depth), frame_slot(spill_slot(compiler, depth - registers->temp_count)));
+    }
 }
 
-static void mov_constant_to_reg(compiler_t* compiler, reg_t dst, int64_t src) {
-    printf("mov %s, %ld\n", reg_to_str(dst), src);
-    compiler->last_used_reg = dst;
+static void mov_constant_to_reg(compiler_t* compiler, int64_t src) {
+    x86_mov_immediate(&compiler->x86, push_temp(compiler), src);
 }
 
-static void codegen_primary(compiler_t* compiler, primary_t* primary) {
-    if (primary->kind == PRIMARY_INTEGER) {
-        mov_constant_to_reg(compiler, compiler->last_used_reg + 1, primary->as.integer);
-    } else if (primary->kind == PRIMARY_IDENTIFIER) {
-        compiled_var_t* var = find_variable(compiler, primary->as.identifier);
+// Variables smaller than a register are zero-extended on load.
+static void load_var(compiler_t* compiler, reg_t dst, compiled_var_t* var) {
+    if (var->reg != REG_NONE) {
+        x86_mov(&compiler->x86, dst, var->reg);
+        return;
+    }
+
+    int size = type_info(compiler->types, var->type)->size;
+    int slot = var->address + size;
 
-        // TODO: no not hardcode the addressing size
-        printf("mov %s, qword [rbp - %d]\n", reg_to_str(compiler->last_used_reg), var->address + var->type.size);
+    if (size == 1) {
+        x86_load_byte(&compiler->x86, dst, frame_slot(slot));
     } else {
-        assert(false && "unimplemented");
+        x86_load(&compiler->x86, dst, frame_slot(slot));
     }
 }
 
-static void codegen_binop(compiler_t* compiler, binary_op_t op) {
-    if (op == BINARY_ADD) {
-        printf("add %s, %s\n", reg_to_str(compiler->last_used_reg - 1), reg_to_str(compiler->last_used_reg));
-        compiler->last_used_reg = compiler->last_used_reg - 1;
-    } else if (op == BINARY_SUB) {
-        printf("sub %s, %s\n", reg_to_str(compiler->last_used_reg - 1), reg_to_str(compiler->last_used_reg));
-        compiler->last_used_reg = compiler->last_used_reg - 1;
-    } else if (op == BINARY_MUL) {
-        printf("imul %s, %s\n", reg_to_str(compiler->last_used_reg - 1), reg_to_str(compiler->last_used_reg));
-        compiler->last_used_reg = compiler->last_used_reg - 1;
-    } else if (op == BINARY_DIV) {
-        if (compiler->last_used_reg > 2) {
-            printf("push rax\n");
-            mov_reg_to_reg(compiler, REG_RAX, compiler->last_used_reg - 1);
-            printf("div %s\n", reg_to_str(compiler->last_used_reg));
-            mov_reg_to_reg(compiler, compiler->last_used_reg - 1, REG_RAX);
-            printf("pop rax\n");
-        } else {
-            printf("div %s\n", reg_to_str(compiler->last_used_reg));
+static void store_var(compiler_t* compiler, compiled_var_t* var, reg_t src) {
+    if (var->reg != REG_NONE) {
+        if (var->reg != src) {
+            x86_mov(&compiler->x86, var->reg, src);
         }
+        return;
+    }
+
+    int size = type_info(compiler->types, var->type)->size;
+    int slot = var->address + size;
 
-        compiler->last_used_reg = compiler->last_used_reg - 1;
+    if (size == 1) {
+        x86_store_byte(&compiler->x86, frame_slot(slot), src);
     } else {
-        assert(false && "unimplemented");
-    }
-}
-
-void codegen_expression(compiler_t* compiler, expression_t* expr) {
-    if (expr->kind == EXPR_PRIMARY) {
-        primary_t* primary = expr->as.primary;
-        codegen_primary(compiler, primary);
-    } else  {
-        binary_t* binary = expr->as.binary;
-        if (is_primary(binary->lhs) && !is_primary(binary->rhs)) {
-            codegen_expression(compiler, binary->rhs);
-            codegen_expression(compiler, binary->lhs);
-            printf("xchg %s, %s\n", reg_to_str(compiler->last_used_reg - 1), reg_to_str(compiler->last_used_reg));
-        } else {
-            codegen_expression(compiler, binary->lhs);
-            codegen_expression(compiler, binary->rhs);
-        }
+        x86_store(&compiler->x86, frame_slot(slot), src);
+    }
+}
+
+static void codegen_variable(compiler_t* compiler, ast_t* ast, node_id_t id) {
+    compiled_var_t* var = find_variable(compiler, ast_node(ast, id)->symbol);
+    load_var(compiler, push_temp(compiler), var);
+}
+
+// idiv works on rax and rdx, which may hold the operands or other values,
+// so both are saved and the divisor is read from the stack.
+static void codegen_division(compiler_t* compiler, reg_t lhs, reg_t rhs) {
+    x86_t* x86 = &compiler->x86;
 
-        codegen_binop(compiler, binary->op);
+    x86_push(x86, REG_RDX);
+    x86_push(x86, REG_RAX);
+    x86_push(x86, rhs);
+    if (lhs != REG_RAX) {
+        x86_mov(x86, REG_RAX, lhs);
     }
+    x86_cqo(x86);
+    x86_idiv(x86, stack_slot(0));
+    x86_store(x86, stack_slot(0), REG_RAX);
+    x86_load(x86, REG_RAX, stack_slot(8));
+    x86_load(x86, REG_RDX, stack_slot(16));
+    x86_load(x86, lhs, stack_slot(0));
+    x86_alu_immediate(x86, X86_ADD, REG_RSP, 24);
 }
 
-void codegen_block(compiler_t* compiler, block_t* block) {
-    for (int i = 0; i < dynarray_length(block->statements); i++) {
-        codegen_statement(compiler, block->statements[i]);
+static void codegen_binop(compiler_t* compiler, binary_op_t op) {
+    reg_t lhs = temp_reg(compiler, compiler->registers.temp_depth - 2);
+    reg_t rhs = temp_reg(compiler, compiler->registers.temp_depth - 1);
+
+    switch (op) {
+        case BINARY_DIV:
+            codegen_division(compiler, lhs, rhs);
+            break;
+        case BINARY_EQUAL:
+        case BINARY_NOT_EQUAL:
+        case BINARY_LESS:
+        case BINARY_GREATER:
+        case BINARY_LESS_EQUAL:
+        case BINARY_GREATER_EQUAL:
+            x86_alu(&compiler->x86, X86_CMP, lhs, rhs);
+            x86_set(&compiler->x86, binop_conditions[op], lhs);
+            x86_zero_extend_byte(&compiler->x86, lhs);
+            break;
+        default:
+            x86_alu(&compiler->x86, binop_instructions[op], lhs, rhs);
+            break;
     }
+
+    pop_temp(compiler);
 }
 
-void codegen_let_assignment(compiler_t* compiler, let_assignment_t* let_assignment) {
-    codegen_expression(compiler, let_assignment->expr);
+// The arguments are the top temporaries. Temporaries below them that are in
+// registers are saved around the call and the arguments are moved into place
+// through the stack, since the two sets overlap. Variables live across the
+// call are in callee-saved registers or on the stack already.
+static compile_error_t codegen_funcall(compiler_t* compiler, ast_t* ast, node_id_t id) {
+    register_allocation_t* registers = &compiler->registers;
+    uint32_t count = ast_node(ast, id)->as.range.count;
+
+    if (count > ARGUMENT_REG_COUNT) {
+        fprintf(compiler->diagnostics, LOCATION_FMT" ERROR: calls with more than %d arguments are not supported\n", LOCATION_ARG(ast_location(ast, id)), ARGUMENT_REG_COUNT);
+        return COMP_ERROR_UNSUPPORTED;
+    }
+
+    int live = registers->temp_depth - count;
+    int lowest = registers->temp_depth - registers->temp_count;
+
+    // A call without arguments leaves one more temporary than it found, so
+    // the one sharing its result's register is spilled.
+    if (count == 0 && lowest >= 0) {
+        x86_store(&compiler->x86, frame_slot(spill_slot(compiler, lowest)), temp_reg(compiler, lowest));
+        lowest++;
+    }
 
-    compiled_var_t* var = find_variable(compiler, let_assignment->name);
+    if (lowest < 0) {
+        lowest = 0;
+    }
+
+    for (int depth = lowest; depth < live; depth++) {
+        x86_push(&compiler->x86, temp_reg(compiler, depth));
+    }
 
-    printf("mov [rbp - %d], rax\n", var->address + var->type.size);
+    for (uint32_t i = 0; i < count; i++) {
+        x86_push(&compiler->x86, temp_reg(compiler, live + i));
+    }
+
+    for (uint32_t i = count; i > 0; i--) {
+        x86_pop(&compiler->x86, argument_regs[i - 1]);
+    }
+
+    // The frame is 16-byte aligned, so an odd number of saved registers
+    // needs padding before the call.
+    bool pad = live > lowest && (live - lowest) % 2 == 1;
+    if (pad) {
+        x86_alu_immediate(&compiler->x86, X86_SUB, REG_RSP, 8);
+    }
+
+    x86_call(&compiler->x86, ast_node(ast, id)->symbol, ast_name(ast, id));
+
+    if (pad) {
+        x86_alu_immediate(&compiler->x86, X86_ADD, REG_RSP, 8);
+    }
+
+    registers->temp_depth = live + 1;
+
+    reg_t result = temp_reg(compiler, live);
+    if (result != REG_RAX) {
+        x86_mov(&compiler->x86, result, REG_RAX);
+    }
+
+    for (int depth = live - 1; depth >= lowest; depth--) {
+        x86_pop(&compiler->x86, temp_reg(compiler, depth));
+    }
+
+    // With the arguments gone, temporaries that were spilled to make room
+    // for them get their registers back.
+    for (int depth = live + 1 - registers->temp_count; depth < lowest; depth++) {
+        if (depth >= 0) {
+            x86_load(&compiler->x86, temp_reg(compiler, depth), frame_slot(spill_slot(compiler, depth)));
+        }
+    }
+
+    return COMP_ERROR_OK;
+}
+
+// Statements start with an empty expression stack, so their value ends up
+// in the first temporary register, rax.
+static void codegen_let_assignment(compiler_t* compiler, ast_t* ast, node_id_t id) {
+    node_t* let_assignment = ast_node(ast, id);
+    compiled_var_t* var = find_variable(compiler, ast_node(ast, let_assignment->as.pair.lhs)->symbol);
+
+    store_var(compiler, var, REG_RAX);
+    compiler->registers.temp_depth = 0;
 }
 
-void codegen_return(compiler_t* compiler, return_t* ret) {
-    if (ret->expr) {
-        codegen_expression(compiler, ret->expr);
+static void codegen_return(compiler_t* compiler) {
+    register_allocation_t* registers = &compiler->registers;
+
+    if (registers->framed) {
+        x86_mov(&compiler->x86, REG_RSP, REG_RBP);
+
+        for (int i = CALLEE_SAVED_REG_COUNT; i > 0; i--) {
+            if (registers->saved & (1u << callee_saved_regs[i - 1])) {
+                x86_pop(&compiler->x86, callee_saved_regs[i - 1]);
+            }
+        }
+
+        x86_pop(&compiler->x86, REG_RBP);
     }
 
-    printf("mov rsp, rbp\n");
-    printf("pop rbp\n");
-    printf("ret\n");
+    x86_ret(&compiler->x86);
+    registers->temp_depth = 0;
 }
 
-void codegen_statement(compiler_t* compiler, statement_t* stmt) {
-    switch (stmt->kind) {
-        case STMT_BLOCK:
-            codegen_block(compiler, stmt->as.block);
-            break;
-        case STMT_LET_ASSIGNMENT:
-            codegen_let_assignment(compiler, stmt->as.let_assignment);
-            break;
-        case STMT_RETURN:
-            codegen_return(compiler, stmt->as.ret);
-            break;
+static compile_error_t codegen_prologue(compiler_t* compiler, ast_t* ast, node_id_t first, node_id_t fundef) {
+    sv_t name = ast_name(ast, first);
+    compiled_function_t* fun = find_function(compiler, ast_node(ast, first)->symbol);
+
+    if (dynarray_length(fun->parameters) > ARGUMENT_REG_COUNT) {
+        fprintf(compiler->diagnostics, LOCATION_FMT" ERROR: functions with more than %d parameters are not supported\n", LOCATION_ARG(ast_location(ast, first)), ARGUMENT_REG_COUNT);
+        return COMP_ERROR_UNSUPPORTED;
+    }
+
+    bool floating = type_has(compiler->types, fun->return_type, TYPE_FLAG_FLOATING);
+    for (size_t i = 0; i < dynarray_length(fun->parameters); i++) {
+        floating = floating || type_has(compiler->types, fun->parameters[i].type, TYPE_FLAG_FLOATING);
     }
+
+    if (floating) {
+        fprintf(compiler->diagnostics, LOCATION_FMT" ERROR: floating point code generation is not supported\n", LOCATION_ARG(ast_location(ast, first)));
+        return COMP_ERROR_UNSUPPORTED;
+    }
+
+    allocate_registers(compiler, ast, fundef);
+    register_allocation_t* registers = &compiler->registers;
+
+    x86_label(&compiler->x86, name);
+
+    if (registers->framed) {
+        x86_push(&compiler->x86, REG_RBP);
+
+        for (int i = 0; i < CALLEE_SAVED_REG_COUNT; i++) {
+            if (registers->saved & (1u << callee_saved_regs[i])) {
+                x86_push(&compiler->x86, callee_saved_regs[i]);
+            }
+        }
+
+        x86_mov(&compiler->x86, REG_RBP, REG_RSP);
+
+        if (registers->frame_size > 0) {
+            x86_alu_immediate(&compiler->x86, X86_SUB, REG_RSP, registers->frame_size);
+        }
+    }
+
+    // Parameters headed for the stack are stored first. The rest may need
+    // each other's registers, so they are moved through the stack.
+    size_t moved = 0;
+    for (size_t i = 0; i < dynarray_length(fun->parameters); i++) {
+        compiled_var_t* var = find_variable(compiler, fun->parameters[i].name);
+
+        if (var->reg == REG_NONE) {
+            store_var(compiler, var, argument_regs[i]);
+        } else if (var->reg != argument_regs[i]) {
+            x86_push(&compiler->x86, argument_regs[i]);
+            moved++;
+        }
+    }
+
+    for (size_t i = dynarray_length(fun->parameters); i > 0 && moved > 0; i--) {
+        compiled_var_t* var = find_variable(compiler, fun->parameters[i - 1].name);
+
+        if (var->reg != REG_NONE && var->reg != argument_regs[i - 1]) {
+            x86_pop(&compiler->x86, var->reg);
+            moved--;
+        }
+    }
+
+    // Only the low byte of a bool argument is defined by the ABI.
+    for (size_t i = 0; i < dynarray_length(fun->parameters); i++) {
+        compiled_var_t* var = find_variable(compiler, fun->parameters[i].name);
+
+        if (var->reg != REG_NONE && type_info(compiler->types, var->type)->size == 1) {
+            x86_zero_extend_byte(&compiler->x86, var->reg);
+        }
+    }
+
+    return COMP_ERROR_OK;
+}
+
+// Nodes are in post-order, which is exactly the order a register stack
+// machine evaluates them in: operands are pushed, operators pop two and
+// push their result.
+compile_error_t codegen_function_definition(compiler_t* compiler, ast_t* ast, node_id_t fundef) {
+    node_id_t first = ast_function_first(ast, fundef);
+
+    compile_error_t error = codegen_prologue(compiler, ast, first, fundef);
+    if (error != COMP_ERROR_OK) {
+        return error;
+    }
+
+    bool returned = false;
+
+    for (node_id_t id = first; id < fundef && error == COMP_ERROR_OK; id++) {
+        node_t* node = ast_node(ast, id);
+
+        switch (node->kind) {
+            case NODE_INTEGER:
+                mov_constant_to_reg(compiler, node->as.integer);
+                break;
+            case NODE_BOOLEAN:
+                mov_constant_to_reg(compiler, node->as.boolean);
+                break;
+            case NODE_IDENTIFIER:
+                codegen_variable(compiler, ast, id);
+                break;
+            case NODE_FUNCALL:
+                error = codegen_funcall(compiler, ast, id);
+                break;
+            case NODE_BINARY:
+                codegen_binop(compiler, node->op);
+                break;
+            case NODE_LET_ASSIGNMENT:
+                codegen_let_assignment(compiler, ast, id);
+                returned = false;
+                break;
+            case NODE_RETURN:
+                codegen_return(compiler);
+                returned = true;
+                break;
+            case NODE_FLOATING:
+                fprintf(compiler->diagnostics, LOCATION_FMT" ERROR: floating point code generation is not supported\n", LOCATION_ARG(ast_location(ast, id)));
+                error = COMP_ERROR_UNSUPPORTED;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (error == COMP_ERROR_OK && !returned) {
+        codegen_return(compiler);
+    }
+
+    return error;
 }
@@ -2,8 +2,6 @@
 
 #include <compiler.h>
 
-void codegen_expression(compiler_t*, expression_t*);
-void codegen_block(compiler_t*, block_t*);
-void codegen_let_assignment(compiler_t*, let_assignment_t*);
-void codegen_return(compiler_t*, return_t*);
-void codegen_statement(compiler_t*, statement_t*);
+// Emits the function to compiler->x86. Expects the scope its body was
+// checked in to still be pushed.
+compile_error_t codegen_function_definition(compiler_t*, ast_t*, node_id_t);
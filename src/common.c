@@ -1,8 +1,50 @@
 #include <common.h>
+#include <errno.h>
+#include <unistd.h>
 
-location_t location_make(int line, int col) {
+location_t location_make(int64_t line, int64_t col) {
     return (location_t) {
         .line = line,
         .col = col,
     };
 }
+
+bool read_all(int fd, void* data, size_t size) {
+    char* bytes = data;
+
+    while (size > 0) {
+        ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return false;
+        }
+
+        bytes += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+    const char* bytes = data;
+
+    while (size > 0) {
+        ssize_t n = write(fd, bytes, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n < 0) {
+            return false;
+        }
+
+        bytes += n;
+        size -= n;
+    }
+
+    return true;
+}
@@ -1,11 +1,20 @@
 #pragma once
 
-#define LOCATION_FMT "(%d:%d)"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOCATION_FMT "(%"PRId64":%"PRId64")"
 #define LOCATION_ARG(arg) arg.line, arg.col
 
 typedef struct {
-    int line;
-    int col;
+    int64_t line;
+    int64_t col;
 } location_t;
 
-location_t location_make(int, int);
+location_t location_make(int64_t, int64_t);
+
+// Both retry short transfers and return false on error or end of file.
+bool read_all(int, void*, size_t);
+bool write_all(int, const void*, size_t);
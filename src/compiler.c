@@ -1,16 +1,10 @@
+#include <alloc.h>
 #include <assert.h>
 #include <compiler.h>
 #include <dynarray/dynarray.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-static type_info_t builtin_type_infos[TYPE_KIND_COUNT] = {
-    [TYPE_KIND_INT]   = { .kind = TYPE_KIND_INT,   .repr = "int", .is_valid_variable_type = true,  .is_valid_return_type = true, .is_valid_arith_binop_type = true,  .is_valid_bool_binop_type = true,   .size = 8, .is_valid_lg_gt_value_type = true  },
-    [TYPE_KIND_FLOAT] = { .kind = TYPE_KIND_FLOAT, .repr = "float", .is_valid_variable_type = true,  .is_valid_return_type = true, .is_valid_arith_binop_type = true,  .is_valid_bool_binop_type = true, .size = 8, .is_valid_lg_gt_value_type = true  },
-    [TYPE_KIND_BOOL]  = { .kind = TYPE_KIND_BOOL,  .repr = "bool", .is_valid_variable_type = true,  .is_valid_return_type = true, .is_valid_arith_binop_type = false, .is_valid_bool_binop_type = true,  .size = 1, .is_valid_lg_gt_value_type = false },
-    [TYPE_KIND_VOID]  = { .kind = TYPE_KIND_VOID,  .repr = "void", .is_valid_variable_type = false, .is_valid_return_type = true, .is_valid_arith_binop_type = false, .is_valid_bool_binop_type = false, .size = 0, .is_valid_lg_gt_value_type = false },
-};
-
 static bool check_op_is_bool(binary_op_t op) {
     switch (op) {
         case BINARY_EQUAL:
@@ -39,43 +33,45 @@ static bool check_op_is_lg_gt(binary_op_t op) {
     }
 }
 
-static compile_error_t check_valid_binop(binary_op_t op, type_info_t lhs, type_info_t rhs) {
-    if (lhs.kind != rhs.kind) {
+static compile_error_t check_valid_binop(type_table_t* types, binary_op_t op, type_id_t lhs, type_id_t rhs) {
+    if (lhs != rhs) {
         return COMP_ERROR_TYPE_MISMATCH;
     }
 
-    if (check_op_is_bool(op) && !lhs.is_valid_bool_binop_type) {
+    if (check_op_is_bool(op) && !type_has(types, lhs, TYPE_FLAG_LOGICAL)) {
         return COMP_ERROR_TYPE_INVALID_OPERANDS;
     }
 
-    if (!check_op_is_bool(op) && !lhs.is_valid_arith_binop_type) {
+    if (!check_op_is_bool(op) && !type_has(types, lhs, TYPE_FLAG_ARITH)) {
         return COMP_ERROR_TYPE_INVALID_OPERANDS;
     }
 
-    if (check_op_is_lg_gt(op) && !lhs.is_valid_lg_gt_value_type) {
+    if (check_op_is_lg_gt(op) && !type_has(types, lhs, TYPE_FLAG_ORDERED)) {
         return COMP_ERROR_TYPE_INVALID_OPERANDS;
     }
 
     return COMP_ERROR_OK;
 }
 
-compiled_var_t compiled_var_make(sv_t name, type_info_t type, int address) {
+compiled_var_t compiled_var_make(symbol_t name, type_id_t type, int address) {
     return (compiled_var_t) {
         .name = name,
         .type = type,
         .address = address,
+        .reg = REG_NONE,
+        .shadowed = SYMBOL_MAP_NONE,
     };
 }
 
-compiled_parameter_t compiled_parameter_make(sv_t name, type_info_t type) {
+compiled_parameter_t compiled_parameter_make(symbol_t name, type_id_t type) {
     return (compiled_parameter_t) {
         .name = name,
         .type = type,
     };
 }
 
-compiled_function_t* compiled_function_make(sv_t name, type_info_t return_type) {
-    compiled_function_t* function = malloc(sizeof(compiled_function_t));
+compiled_function_t* compiled_function_make(symbol_t name, type_id_t return_type) {
+    compiled_function_t* function = mem_alloc(sizeof(compiled_function_t));
     function->name = name;
     function->return_type = return_type;
 
@@ -84,102 +80,155 @@ compiled_function_t* compiled_function_make(sv_t name, type_info_t return_type)
 
 void compiled_function_free(compiled_function_t* function) {
     dynarray_destroy(function->parameters);
-    free(function);
+    mem_free(function);
 }
 
 void compiler_init(compiler_t* compiler) {
-    compiler->scope = NULL;
+    compiler->vars = dynarray_create(compiled_var_t);
+    compiler->scopes = dynarray_create(size_t);
+    symbol_map_init(&compiler->var_index);
     compiler->frame_size = 0;
 
-    compiler->last_used_reg = REG_NONE;
-    compiler->functions = dynarray_create(compiled_function_t*);
+    compiler->registers = (register_allocation_t) { 0 };
+    compiler->functions = mem_alloc(sizeof(function_table_t));
+    compiler->functions->functions = dynarray_create(compiled_function_t*);
+    symbol_map_init(&compiler->functions->index);
+    compiler->types = mem_alloc(sizeof(type_table_t));
+    type_table_init(compiler->types);
+    compiler->owns_tables = true;
+
+    x86_init(&compiler->x86);
+    compiler->diagnostics = stderr;
+    compiler->lookups = 0;
+}
+
+void compiler_init_worker(compiler_t* worker, compiler_t* program) {
+    compiler_init(worker);
+    dynarray_destroy(worker->functions->functions);
+    symbol_map_deinit(&worker->functions->index);
+    mem_free(worker->functions);
+    type_table_deinit(worker->types);
+    mem_free(worker->types);
+
+    worker->functions = program->functions;
+    worker->types = program->types;
+    worker->owns_tables = false;
 }
 
 void compiler_deinit(compiler_t* compiler) {
-    for (int i = 0; i < dynarray_length(compiler->functions); i++) {
-        compiled_function_free(compiler->functions[i]);
+    dynarray_destroy(compiler->vars);
+    dynarray_destroy(compiler->scopes);
+    symbol_map_deinit(&compiler->var_index);
+    x86_deinit(&compiler->x86);
+
+    if (!compiler->owns_tables) {
+        return;
     }
 
-    dynarray_destroy(compiler->functions);
-}
+    type_table_deinit(compiler->types);
+    mem_free(compiler->types);
 
-scope_t* scope_make() {
-    scope_t* scope = malloc(sizeof(scope_t));
-    scope->parent = NULL;
-    scope->vars = dynarray_create(compiled_var_t);
+    function_table_t* table = compiler->functions;
+    for (size_t i = 0; i < dynarray_length(table->functions); i++) {
+        compiled_function_free(table->functions[i]);
+    }
 
-    return scope;
+    dynarray_destroy(table->functions);
+    symbol_map_deinit(&table->index);
+    mem_free(table);
 }
 
-void scope_free(scope_t* scope) {
-    dynarray_destroy(scope->vars);
-    free(scope);
+void compiler_reset(compiler_t* compiler) {
+    function_table_t* table = compiler->functions;
+    for (size_t i = 0; i < dynarray_length(table->functions); i++) {
+        compiled_function_free(table->functions[i]);
+    }
+
+    _dynarray_field_set(table->functions, LENGTH, 0);
+    symbol_map_clear(&table->index);
 }
 
 void push_scope(compiler_t* compiler)  {
-    scope_t* child = scope_make();
-    child->parent = compiler->scope;
-    compiler->scope = child;
+    dynarray_push_rval(compiler->scopes, (size_t) dynarray_length(compiler->vars));
 }
 
+// Unbinds the scope's variables innermost first, so each name falls back to
+// the binding it shadowed.
 void pop_scope(compiler_t* compiler) {
-    scope_t* current = compiler->scope;
-    compiler->scope = current->parent;
+    size_t mark;
+    dynarray_pop(compiler->scopes, &mark);
 
     int dealloc_size = 0;
-    for (int i = 0; i < dynarray_length(current->vars); i++) {
-        dealloc_size += current->vars[i].type.size;
+    for (size_t i = dynarray_length(compiler->vars); i > mark; i--) {
+        compiled_var_t* var = &compiler->vars[i - 1];
+
+        if (var->shadowed != SYMBOL_MAP_NONE) {
+            symbol_map_put(&compiler->var_index, var->name, var->shadowed);
+        } else {
+            symbol_map_remove(&compiler->var_index, var->name);
+        }
+
+        dealloc_size += type_info(compiler->types, var->type)->size;
     }
 
+    _dynarray_field_set(compiler->vars, LENGTH, mark);
     compiler->frame_size -= dealloc_size;
-    scope_free(current);
 }
 
 void insert_var(compiler_t* compiler, compiled_var_t compiled_var) {
-    scope_t* current = compiler->scope;
-    dynarray_push(current->vars, compiled_var);
+    uint32_t index = dynarray_length(compiler->vars);
 
-    compiler->frame_size += compiled_var.type.size;
+    compiled_var.shadowed = symbol_map_put(&compiler->var_index, compiled_var.name, index);
+    dynarray_push(compiler->vars, compiled_var);
+
+    compiler->frame_size += type_info(compiler->types, compiled_var.type)->size;
 }
 
-compiled_var_t* find_variable(compiler_t* compiler, sv_t name) {
-    compiled_var_t* var = NULL;
+compiled_var_t* find_variable(compiler_t* compiler, symbol_t name) {
+    compiler->lookups++;
+    uint32_t index = symbol_map_get(&compiler->var_index, name);
+    return index != SYMBOL_MAP_NONE ? &compiler->vars[index] : NULL;
+}
 
-    for (scope_t* scope = compiler->scope; scope != NULL; scope = scope->parent) {
-        for (int i = 0; i < dynarray_length(scope->vars); i++) {
-            if (sv_equals(scope->vars[i].name, name)) {
-                var = &scope->vars[i];
-            }
-        }
-    }
+void insert_fun(compiler_t* compiler, compiled_function_t* fun) {
+    function_table_t* table = compiler->functions;
 
-    return var;
+    symbol_map_put(&table->index, fun->name, dynarray_length(table->functions));
+    dynarray_push(table->functions, fun);
 }
 
-void insert_fun(compiler_t* compiler, compiled_function_t* fun) {
-    dynarray_push(compiler->functions, fun);
+compiled_function_t* find_function(compiler_t* compiler, symbol_t name) {
+    compiler->lookups++;
+    function_table_t* table = compiler->functions;
+
+    uint32_t index = symbol_map_get(&table->index, name);
+    return index != SYMBOL_MAP_NONE ? table->functions[index] : NULL;
 }
 
-compiled_function_t* find_function(compiler_t* compiler, sv_t name) {
-    compiled_function_t* fun = NULL;
+// Types computed for the nodes of the function being checked, indexed from
+// the function's first node.
+typedef struct {
+    ast_t* ast;
+    node_id_t first;
+    type_id_t* types;
+} function_check_t;
 
-    for (int i = 0; i < dynarray_length(compiler->functions); i++) {
-        if (sv_equals(compiler->functions[i]->name, name)) {
-            fun = compiler->functions[i];
-        }
-    }
+static type_id_t* type_of(function_check_t* check, node_id_t id) {
+    return &check->types[id - check->first];
+}
 
-    return fun;
+static sv_t type_name(compiler_t* compiler, ast_t* ast, type_id_t type) {
+    return ast_symbol_name(ast, type_info(compiler->types, type)->name);
 }
 
-static compile_error_t resolve_variable(compiler_t* compiler, type_info_t* type_info, primary_t* primary) {
-    compiled_var_t* var = find_variable(compiler, primary->as.identifier);
+static compile_error_t resolve_variable(compiler_t* compiler, function_check_t* check, node_id_t id) {
+    compiled_var_t* var = find_variable(compiler, ast_node(check->ast, id)->symbol);
     if (!var) {
-        fprintf(stderr, LOCATION_FMT" ERROR: referenced variable '"SV_FMT"' does not exists\n", LOCATION_ARG(primary->location), SV_ARG(primary->as.identifier));
+        fprintf(compiler->diagnostics, LOCATION_FMT" ERROR: referenced variable '"SV_FMT"' does not exists\n", LOCATION_ARG(ast_location(check->ast, id)), SV_ARG(ast_name(check->ast, id)));
         return COMP_ERROR_VAR_NOT_EXISTS;
     }
 
-    *type_info = var->type;
+    *type_of(check, id) = var->type;
     return COMP_ERROR_OK;
 }
 
@@ -199,257 +248,239 @@ static bool is_binop_result_bool(binary_op_t op) {
     }
 }
 
-compile_error_t compile_funcall(compiler_t* compiler, type_info_t* type_info, funcall_t* funcall) {
-    compiled_function_t* fun = find_function(compiler, funcall->name);
+static compile_error_t compile_funcall(compiler_t* compiler, function_check_t* check, node_id_t id) {
+    ast_t* ast = check->ast;
+    node_t* funcall = ast_node(ast, id);
+    sv_t name = ast_name(ast, id);
+
+    compiled_function_t* fun = find_function(compiler, funcall->symbol);
     if (!fun) {
-        fprintf(stderr,
+        fprintf(compiler->diagnostics,
                 LOCATION_FMT" ERROR: no such function '"SV_FMT"'\n",
-                LOCATION_ARG(funcall->location),
-                SV_ARG(funcall->name));
+                LOCATION_ARG(ast_location(ast, id)),
+                SV_ARG(name));
 
         return COMP_ERROR_FUN_NOT_EXISTS;
     }
 
-    if (dynarray_length(fun->parameters) != dynarray_length(funcall->arguments)) {
-        fprintf(stderr,
-                LOCATION_FMT" ERROR: '"SV_FMT"' expected %zu arguments, but got %zu\n",
-                LOCATION_ARG(funcall->location),
-                SV_ARG(funcall->name), dynarray_length(fun->parameters), dynarray_length(funcall->arguments));
+    if (dynarray_length(fun->parameters) != funcall->as.range.count) {
+        fprintf(compiler->diagnostics,
+                LOCATION_FMT" ERROR: '"SV_FMT"' expected %zu arguments, but got %u\n",
+                LOCATION_ARG(ast_location(ast, id)),
+                SV_ARG(name), dynarray_length(fun->parameters), funcall->as.range.count);
 
         return COMP_ERROR_FUN_ARITY_NOT_MATCH;
     }
 
-    for (int i = 0; i < dynarray_length(funcall->arguments); i++) {
-        type_info_t expr_type = {0};
-        compile_expression(compiler, &expr_type, funcall->arguments[i]);
+    for (uint32_t i = 0; i < funcall->as.range.count; i++) {
+        node_id_t argument = ast_child(ast, funcall->as.range, i);
+        type_id_t expr_type = *type_of(check, argument);
 
-        if (fun->parameters[i].type.kind != expr_type.kind) {
-            fprintf(stderr,
-                    LOCATION_FMT" ERROR: '"SV_FMT"' parameter type for function '"SV_FMT"' does not match. expected '%s', but got '%s'\n",
-                    LOCATION_ARG(funcall->arguments[i]->location),
-                    SV_ARG(fun->parameters[i].name),
-                    SV_ARG(fun->name),
-                    fun->parameters[i].type.repr,
-                    expr_type.repr);
+        if (fun->parameters[i].type != expr_type) {
+            fprintf(compiler->diagnostics,
+                    LOCATION_FMT" ERROR: '"SV_FMT"' parameter type for function '"SV_FMT"' does not match. expected '"SV_FMT"', but got '"SV_FMT"'\n",
+                    LOCATION_ARG(ast_location(ast, argument)),
+                    SV_ARG(ast_symbol_name(ast, fun->parameters[i].name)),
+                    SV_ARG(name),
+                    SV_ARG(type_name(compiler, ast, fun->parameters[i].type)),
+                    SV_ARG(type_name(compiler, ast, expr_type)));
 
             return COMP_ERROR_TYPE_MISMATCH;
         }
     }
 
-    *type_info = fun->return_type;
+    *type_of(check, id) = fun->return_type;
 
     return COMP_ERROR_OK;
 }
 
-compile_error_t compile_expression(compiler_t* compiler, type_info_t* type_info, expression_t* expr) {
-    if (expr->kind == EXPR_PRIMARY) {
-        primary_t* primary = expr->as.primary;
-
-        switch (primary->kind) {
-            case PRIMARY_INTEGER:
-                *type_info = builtin_type_infos[TYPE_KIND_INT];
-                return COMP_ERROR_OK;
-            case PRIMARY_FLOATING:
-                *type_info = builtin_type_infos[TYPE_KIND_FLOAT];
-                return COMP_ERROR_OK;
-            case PRIMARY_IDENTIFIER:
-                return resolve_variable(compiler, type_info, primary);
-            case PRIMARY_BOOLEAN:
-                *type_info = builtin_type_infos[TYPE_KIND_BOOL];
-                return COMP_ERROR_OK;
-            case PRIMARY_FUNCALL:
-                return compile_funcall(compiler, type_info, primary->as.funcall);
-        }
-    } else {
-        binary_t* binary = expr->as.binary;
-
-        type_info_t lhs;
-        compile_error_t err = compile_expression(compiler, &lhs, binary->lhs);
-        if (err != COMP_ERROR_OK) {
-            return err;
-        }
-
-        type_info_t rhs;
-        err = compile_expression(compiler, &rhs, binary->rhs);
-        if (err != COMP_ERROR_OK) {
-            return err;
-        }
-
-        compile_error_t error = check_valid_binop(binary->op, lhs, rhs);
+static compile_error_t compile_binary(compiler_t* compiler, function_check_t* check, node_id_t id) {
+    node_t* binary = ast_node(check->ast, id);
+    type_id_t lhs = *type_of(check, binary->as.pair.lhs);
+    type_id_t rhs = *type_of(check, binary->as.pair.rhs);
 
-        switch (error) {
-            case COMP_ERROR_TYPE_MISMATCH:
-                fprintf(stderr, LOCATION_FMT" ERROR: binary expr type mismatch:\n  lhs -> %s\n  rhs -> %s\n", LOCATION_ARG(binary->location), lhs.repr, rhs.repr);
-                return error;
-            case COMP_ERROR_TYPE_INVALID_OPERANDS:
-                fprintf(stderr, LOCATION_FMT" ERROR: binary expr unsupported operands:\n  lhs -> %s\n  rhs -> %s\n", LOCATION_ARG(binary->location), lhs.repr, rhs.repr);
-                return error;
-            default:
-                if (is_binop_result_bool(binary->op)) {
-                    *type_info = builtin_type_infos[TYPE_KIND_BOOL];
-                } else {
-                    *type_info = lhs;
-                }
-                return error;
-        }
-    }
-}
+    compile_error_t error = check_valid_binop(compiler->types, binary->op, lhs, rhs);
 
-compile_error_t compile_block(compiler_t* compiler, type_info_t* type_info, block_t* block) {
-    for (int i = 0; i < dynarray_length(block->statements); i++) {
-        compile_error_t error = compile_statement(compiler, type_info, block->statements[i]);
-        if (error != COMP_ERROR_OK) {
+    switch (error) {
+        case COMP_ERROR_TYPE_MISMATCH:
+            fprintf(compiler->diagnostics, LOCATION_FMT" ERROR: binary expr type mismatch:\n  lhs -> "SV_FMT"\n  rhs -> "SV_FMT"\n", LOCATION_ARG(ast_location(check->ast, id)), SV_ARG(type_name(compiler, check->ast, lhs)), SV_ARG(type_name(compiler, check->ast, rhs)));
+            return error;
+        case COMP_ERROR_TYPE_INVALID_OPERANDS:
+            fprintf(compiler->diagnostics, LOCATION_FMT" ERROR: binary expr unsupported operands:\n  lhs -> "SV_FMT"\n  rhs -> "SV_FMT"\n", LOCATION_ARG(ast_location(check->ast, id)), SV_ARG(type_name(compiler, check->ast, lhs)), SV_ARG(type_name(compiler, check->ast, rhs)));
+            return error;
+        default:
+            if (is_binop_result_bool(binary->op)) {
+                *type_of(check, id) = TYPE_BOOL;
+            } else {
+                *type_of(check, id) = lhs;
+            }
             return error;
-        }
     }
-
-    return COMP_ERROR_OK;
 }
 
-compile_error_t compile_let_assignment(compiler_t* compiler, let_assignment_t* let_assignment) {
-    type_info_t expr_type = {0};
-    compile_error_t error = compile_expression(compiler, &expr_type, let_assignment->expr);
-
-    if (error != COMP_ERROR_OK) {
-        return error;
-    }
+static compile_error_t compile_let_assignment(compiler_t* compiler, function_check_t* check, node_id_t id) {
+    node_t* let_assignment = ast_node(check->ast, id);
+    symbol_t name = ast_node(check->ast, let_assignment->as.pair.lhs)->symbol;
+    type_id_t expr_type = *type_of(check, let_assignment->as.pair.rhs);
 
-    if (find_variable(compiler, let_assignment->name)) {
-        fprintf(stderr, 
+    if (find_variable(compiler, name)) {
+        fprintf(compiler->diagnostics, 
                 LOCATION_FMT" ERROR: cannot declare variable '"SV_FMT"' since it's already exists\n",
-                LOCATION_ARG(let_assignment->location),
-                SV_ARG(let_assignment->name));
+                LOCATION_ARG(ast_location(check->ast, id)),
+                SV_ARG(ast_symbol_name(check->ast, name)));
         return COMP_ERROR_VAR_ALREADY_EXISTS;
     }
 
-    compiled_var_t compiled_var = compiled_var_make(let_assignment->name, expr_type, compiler->frame_size);
+    compiled_var_t compiled_var = compiled_var_make(name, expr_type, compiler->frame_size);
     insert_var(compiler, compiled_var);
 
     return COMP_ERROR_OK;
 }
 
-compile_error_t compile_return(compiler_t* compiler, type_info_t* type_info, return_t* ret) {
-    if (ret->expr) {
-        return compile_expression(compiler, type_info, ret->expr);
-    }
+// Parameters are checked in order, so only the ones already collected can
+// clash with this one.
+static compile_error_t compile_parameter(compiler_t* compiler, ast_t* ast, compiled_parameter_t** params, node_id_t id) {
+    node_t* parameter = ast_node(ast, id);
+    symbol_t name = parameter->symbol;
+    sv_t type_name = ast_name(ast, parameter->as.pair.lhs);
 
-    return COMP_ERROR_OK;
-}
-
-compile_error_t compile_statement(compiler_t* compiler, type_info_t* type_info, statement_t* stmt) {
-    switch (stmt->kind) {
-        case STMT_BLOCK:
-            return compile_block(compiler, type_info, stmt->as.block);
-        case STMT_LET_ASSIGNMENT:
-            return compile_let_assignment(compiler, stmt->as.let_assignment);
-        case STMT_RETURN:
-            return compile_return(compiler, type_info, stmt->as.ret);
-    }
-}
-
-static type_info_t* resolve_type(compiler_t* compiler, sv_t type) {
-    if (sv_equals(type, sv_make_from("int"))) {
-        return &builtin_type_infos[TYPE_KIND_INT];
-    } else if (sv_equals(type, sv_make_from("float"))) {
-        return &builtin_type_infos[TYPE_KIND_FLOAT];
-    }  else if (sv_equals(type, sv_make_from("bool"))) {
-        return &builtin_type_infos[TYPE_KIND_BOOL];
-    } else if (sv_equals(type, sv_make_from("void"))) {
-        return &builtin_type_infos[TYPE_KIND_VOID];
-    } else {
-        return NULL;
-    }
-}
-
-compile_error_t compile_parameter(compiler_t* compiler, compiled_parameter_t* compiled_parameter, parameter_t parameter) {
-    type_info_t* type = resolve_type(compiler, parameter.type);
-    if (!type) {
-        fprintf(stderr, LOCATION_FMT" ERROR: no such type '"SV_FMT"'\n", LOCATION_ARG(parameter.location), SV_ARG(parameter.type));
+    type_id_t type = type_table_find(compiler->types, ast_node(ast, parameter->as.pair.lhs)->symbol);
+    if (type == TYPE_NONE) {
+        fprintf(compiler->diagnostics, LOCATION_FMT" ERROR: no such type '"SV_FMT"'\n", LOCATION_ARG(ast_location(ast, id)), SV_ARG(type_name));
         return COMP_ERROR_TYPE_NOT_EXISTS;
     }
 
-    if (!type->is_valid_variable_type) {
-        fprintf(stderr, LOCATION_FMT" ERROR: cannot make a parameter out of '"SV_FMT"'\n", LOCATION_ARG(parameter.location), SV_ARG(parameter.type));
+    if (!type_has(compiler->types, type, TYPE_FLAG_VARIABLE)) {
+        fprintf(compiler->diagnostics, LOCATION_FMT" ERROR: cannot make a parameter out of '"SV_FMT"'\n", LOCATION_ARG(ast_location(ast, id)), SV_ARG(type_name));
         return COMP_ERROR_UNEXPECTED_TYPE;
     }
 
-    *compiled_parameter = compiled_parameter_make(parameter.name, *type);
+    for (size_t i = 0; i < dynarray_length(*params); i++) {
+        if ((*params)[i].name == name) {
+            fprintf(compiler->diagnostics,
+                    LOCATION_FMT" ERROR: cannot declare parameter '"SV_FMT"' since it's already exists\n",
+                    LOCATION_ARG(ast_location(ast, id)),
+                    SV_ARG(ast_symbol_name(ast, name)));
+            return COMP_ERROR_VAR_ALREADY_EXISTS;
+        }
+    }
+
+    dynarray_push_rval(*params, compiled_parameter_make(name, type));
 
     return COMP_ERROR_OK;
 }
 
-compile_error_t compile_function_signature(compiler_t* compiler, type_info_t* type_info, compiled_parameter_t** parameters, function_signature_t* funsig) {
-    if (find_function(compiler, funsig->name)) {
-        fprintf(stderr,
+compile_error_t compile_function_signature(compiler_t* compiler, ast_t* ast, node_id_t fundef) {
+    node_t* node = ast_node(ast, fundef);
+    node_id_t name = ast_child(ast, node->as.range, FUNCTION_NAME);
+    node_id_t return_type = ast_child(ast, node->as.range, FUNCTION_RETURN_TYPE);
+
+    if (find_function(compiler, ast_node(ast, name)->symbol)) {
+        fprintf(compiler->diagnostics,
                 LOCATION_FMT" ERROR: cannot declare function '"SV_FMT"' since it's already exists\n",
-                LOCATION_ARG(funsig->location),
-                SV_ARG(funsig->name));
+                LOCATION_ARG(ast_location(ast, fundef)),
+                SV_ARG(ast_name(ast, name)));
 
         return COMP_ERROR_FUN_ALREADY_EXISTS;
     }
 
-    type_info_t* type = resolve_type(compiler, funsig->return_type);
-    if (!type) {
-        fprintf(stderr, LOCATION_FMT" ERROR: no such type '"SV_FMT"'\n", LOCATION_ARG(funsig->location), SV_ARG(funsig->return_type));
+    type_id_t type = type_table_find(compiler->types, ast_node(ast, return_type)->symbol);
+    if (type == TYPE_NONE) {
+        fprintf(compiler->diagnostics, LOCATION_FMT" ERROR: no such type '"SV_FMT"'\n", LOCATION_ARG(ast_location(ast, fundef)), SV_ARG(ast_name(ast, return_type)));
         return COMP_ERROR_TYPE_NOT_EXISTS;
     }
 
     compiled_parameter_t* params = dynarray_create(compiled_parameter_t);
-    for (int i = 0; i < dynarray_length(funsig->parameters); i++) {
-        compiled_parameter_t param = {0};
-        compile_error_t error = compile_parameter(compiler, &param, funsig->parameters[i]);
 
+    for (uint32_t i = FUNCTION_PARAMETERS; i < node->as.range.count; i++) {
+        compile_error_t error = compile_parameter(compiler, ast, &params, ast_child(ast, node->as.range, i));
         if (error != COMP_ERROR_OK) {
+            dynarray_destroy(params);
             return error;
         }
-
-        for (int i = 0; i < dynarray_length(params); i++) {
-            if (sv_equals(params[i].name, param.name)) {
-                fprintf(stderr,
-                        LOCATION_FMT" ERROR: cannot declare parameter '"SV_FMT"' since it's already exists\n",
-                        LOCATION_ARG(funsig->parameters[i].location),
-                        SV_ARG(param.name));
-                return COMP_ERROR_VAR_ALREADY_EXISTS;
-            }
-        }
-
-        dynarray_push(params, param);
     }
 
-    *type_info = *type;
-    *parameters = params;
+    compiled_function_t* fun = compiled_function_make(ast_node(ast, name)->symbol, type);
+    fun->parameters = params;
+    insert_fun(compiler, fun);
 
     return COMP_ERROR_OK;
 }
 
-compile_error_t compile_function_definition(compiler_t* compiler, function_definition_t* fundef) {
-    type_info_t funsig_type = {0};
-    compiled_parameter_t* params = NULL;
+// The nodes of a function are laid out in post-order, so one pass in id order
+// sees every operand before its operator and every declaration before the
+// statements after it.
+static compile_error_t check_function(compiler_t* compiler, function_check_t* check, compiled_function_t* fun, node_id_t fundef) {
+    ast_t* ast = check->ast;
 
-    compile_error_t error = compile_function_signature(compiler, &funsig_type, &params, fundef->funsig);
-    if (error != COMP_ERROR_OK) {
-        return error;
+    for (size_t i = 0; i < dynarray_length(fun->parameters); i++) {
+        insert_var(compiler, compiled_var_make(fun->parameters[i].name, fun->parameters[i].type, compiler->frame_size));
     }
 
-    for (int i = 0; i < dynarray_length(params); i++) {
-        compiled_var_t var = compiled_var_make(params[i].name, params[i].type, compiler->frame_size);
-        insert_var(compiler, var);
+    type_id_t return_type = TYPE_VOID;
+    compile_error_t error = COMP_ERROR_OK;
+
+    for (node_id_t id = check->first; id < fundef && error == COMP_ERROR_OK; id++) {
+        node_t* node = ast_node(ast, id);
+
+        switch (node->kind) {
+            case NODE_INTEGER:
+                *type_of(check, id) = TYPE_INT;
+                break;
+            case NODE_FLOATING:
+                *type_of(check, id) = TYPE_FLOAT;
+                break;
+            case NODE_BOOLEAN:
+                *type_of(check, id) = TYPE_BOOL;
+                break;
+            case NODE_IDENTIFIER:
+                error = resolve_variable(compiler, check, id);
+                break;
+            case NODE_FUNCALL:
+                error = compile_funcall(compiler, check, id);
+                break;
+            case NODE_BINARY:
+                error = compile_binary(compiler, check, id);
+                break;
+            case NODE_LET_ASSIGNMENT:
+                error = compile_let_assignment(compiler, check, id);
+                break;
+            case NODE_RETURN:
+                if (node->as.pair.lhs != NODE_NONE) {
+                    return_type = *type_of(check, node->as.pair.lhs);
+                }
+                break;
+            default:
+                break;
+        }
     }
 
-    type_info_t return_type = builtin_type_infos[TYPE_KIND_VOID];
-    error = compile_block(compiler, &return_type, fundef->body);
     if (error != COMP_ERROR_OK) {
         return error;
     }
 
-    if (funsig_type.kind != return_type.kind) {
-        fprintf(stderr, LOCATION_FMT" ERROR: unexpected return type. expected '%s', but got '%s'\n", LOCATION_ARG(fundef->location), funsig_type.repr, return_type.repr);
+    if (fun->return_type != return_type) {
+        fprintf(compiler->diagnostics, LOCATION_FMT" ERROR: unexpected return type. expected '"SV_FMT"', but got '"SV_FMT"'\n", LOCATION_ARG(ast_location(ast, fundef)), SV_ARG(type_name(compiler, ast, fun->return_type)), SV_ARG(type_name(compiler, ast, return_type)));
         return COMP_ERROR_UNEXPECTED_TYPE;
     }
 
-    compiled_function_t* fun = compiled_function_make(fundef->funsig->name, return_type);
-    fun->parameters = params;
-    insert_fun(compiler, fun);
-
     return COMP_ERROR_OK;
 }
+
+compile_error_t compile_function_definition(compiler_t* compiler, ast_t* ast, node_id_t fundef) {
+    function_check_t check = {
+        .ast = ast,
+        .first = ast_function_first(ast, fundef),
+    };
+
+    compiled_function_t* fun = find_function(compiler, ast_node(ast, check.first)->symbol);
+    assert(fun && "signature must be compiled first");
+
+    check.types = mem_alloc(sizeof(type_id_t) * (fundef - check.first + 1));
+
+    compile_error_t error = check_function(compiler, &check, fun, fundef);
+
+    mem_free(check.types);
+
+    return error;
+}
@@ -2,94 +2,107 @@
 
 #include <ast.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <sv/sv.h>
-
-typedef enum {
-    TYPE_KIND_INT,
-    TYPE_KIND_FLOAT,
-    TYPE_KIND_BOOL,
-    TYPE_KIND_VOID,
-    TYPE_KIND_COUNT,
-} type_kind_t;
+#include <symbol_map.h>
+#include <type.h>
+#include <x86.h>
 
 typedef struct {
-    type_kind_t kind;
-    const char* repr;
-    bool is_valid_variable_type;
-    bool is_valid_return_type;
-    bool is_valid_arith_binop_type;
-    bool is_valid_bool_binop_type;
-    bool is_valid_lg_gt_value_type;
-    int size;
-} type_info_t;
-
-typedef struct {
-    sv_t name;
-    type_info_t type;
+    symbol_t name;
+    type_id_t type;
 
     int address;
+
+    // The register the variable lives in, or REG_NONE when it lives in its
+    // stack slot at `address`. Set by allocate_registers before codegen.
+    reg_t reg;
+
+    // The binding of the same name this one hides, as an index into the
+    // variable stack, or SYMBOL_MAP_NONE.
+    uint32_t shadowed;
 } compiled_var_t;
 
-compiled_var_t compiled_var_make(sv_t, type_info_t, int);
+compiled_var_t compiled_var_make(symbol_t, type_id_t, int);
 
 typedef struct {
-    sv_t name;
-    type_info_t type;
+    symbol_t name;
+    type_id_t type;
 } compiled_parameter_t;
 
-compiled_parameter_t compiled_parameter_make(sv_t, type_info_t);
+compiled_parameter_t compiled_parameter_make(symbol_t, type_id_t);
 
 typedef struct {
-    sv_t name;
-    type_info_t return_type;
+    symbol_t name;
+    type_id_t return_type;
 
     compiled_parameter_t* parameters;
 } compiled_function_t;
 
-compiled_function_t* compiled_function_make(sv_t, type_info_t);
+compiled_function_t* compiled_function_make(symbol_t, type_id_t);
 void compiled_function_free(compiled_function_t*);
 
-typedef enum {
-    REG_NONE,
-    REG_RAX,
-    REG_RBX,
-    REG_RCX,
-    REG_RDX,
-    REG_RDI,
-    REG_RSI,
-    REG_RBP,
-    REG_RSP,
-} reg_t;
-
-typedef struct scope_t scope_t;
-
-struct scope_t {
-    scope_t* parent;
-    compiled_var_t* vars;
-};
+// How the function being emitted uses registers. Expression temporaries
+// form a stack rotating through the first `temp_count` temporary registers;
+// when a deeper temporary needs a register in use, the shallower one is
+// spilled to its slot at `spill_offset`.
+typedef struct {
+    int temp_count;
+    int temp_depth;
+    int spill_offset;
+    int frame_size;
 
-scope_t* scope_make();
-void scope_free(scope_t*);
+    // Callee-saved registers taken by locals, one bit per reg_t. A function
+    // with no frame, saved registers or calls does not set up rbp.
+    uint32_t saved;
+    bool framed;
+} register_allocation_t;
 
 typedef struct {
-    scope_t* scope;
+    compiled_function_t** functions;
+    symbol_map_t index;
+} function_table_t;
+
+// Variables live on one stack, innermost scope last, and `scopes` holds the
+// stack height at each push_scope. `var_index` maps a name to its most
+// recent binding on the stack.
+//
+// The function table is filled by the signature pass and only read while
+// bodies are compiled, so worker compilers share their program's function
+// and type tables and keep their own scopes and streams.
+typedef struct {
+    compiled_var_t* vars;
+    size_t* scopes;
+    symbol_map_t var_index;
     int frame_size;
 
-    reg_t last_used_reg;
-    compiled_function_t** functions;
+    register_allocation_t registers;
+    function_table_t* functions;
+    type_table_t* types;
+    bool owns_tables;
+
+    x86_t x86;
+    FILE* diagnostics;
+
+    // Variable and function lookups, for --time-passes.
+    size_t lookups;
 } compiler_t;
 
 void compiler_init(compiler_t*);
+void compiler_init_worker(compiler_t*, compiler_t*);
 void compiler_deinit(compiler_t*);
 
+// Forgets every function so the compiler can take another program.
+void compiler_reset(compiler_t*);
+
 void push_scope(compiler_t*);
 void pop_scope(compiler_t*);
 
 void insert_var(compiler_t*, compiled_var_t);
-compiled_var_t* find_variable(compiler_t*, sv_t);
+compiled_var_t* find_variable(compiler_t*, symbol_t);
 
 void insert_fun(compiler_t*, compiled_function_t*);
-compiled_function_t* find_function(compiler_t*, sv_t);
+compiled_function_t* find_function(compiler_t*, symbol_t);
 
 typedef enum {
     COMP_ERROR_TYPE_MISMATCH,
@@ -101,15 +114,13 @@ typedef enum {
     COMP_ERROR_FUN_ALREADY_EXISTS,
     COMP_ERROR_FUN_NOT_EXISTS,
     COMP_ERROR_FUN_ARITY_NOT_MATCH,
+    COMP_ERROR_DIVISION_BY_ZERO,
+    COMP_ERROR_UNSUPPORTED,
     COMP_ERROR_OK,
 } compile_error_t;
 
-compile_error_t compile_funcall(compiler_t*, type_info_t*, funcall_t*);
-compile_error_t compile_expression(compiler_t*, type_info_t*, expression_t*);
-compile_error_t compile_block(compiler_t*, type_info_t*, block_t*);
-compile_error_t compile_let_assignment(compiler_t*, let_assignment_t*);
-compile_error_t compile_return(compiler_t*, type_info_t*, return_t*);
-compile_error_t compile_statement(compiler_t*, type_info_t*, statement_t*);
-compile_error_t compile_parameter(compiler_t*, compiled_parameter_t*, parameter_t);
-compile_error_t compile_function_signature(compiler_t*, type_info_t*, compiled_parameter_t**, function_signature_t*);
-compile_error_t compile_function_definition(compiler_t*, function_definition_t*);
+compile_error_t compile_function_signature(compiler_t*, ast_t*, node_id_t);
+
+// Checks a body against the signature collected for it. The caller pushes
+// the function's scope, which holds its frame until the scope is popped.
+compile_error_t compile_function_definition(compiler_t*, ast_t*, node_id_t);
@@ -0,0 +1,180 @@
+#include <elf.h>
+#include <elf64.h>
+#include <string.h>
+
+#define EXECUTABLE_BASE 0x400000
+#define EXECUTABLE_HEADERS 2
+
+#define OBJECT_CODE_OFFSET sizeof(Elf64_Ehdr)
+#define EXECUTABLE_CODE_OFFSET (sizeof(Elf64_Ehdr) + EXECUTABLE_HEADERS * sizeof(Elf64_Phdr))
+
+typedef enum {
+    SECTION_NULL,
+    SECTION_TEXT,
+    SECTION_SYMTAB,
+    SECTION_STRTAB,
+    SECTION_SHSTRTAB,
+    SECTION_NOTE_GNU_STACK,
+    SECTION_COUNT,
+} section_t;
+
+// Offsets into the section name table below.
+static const uint32_t section_names[SECTION_COUNT] = {
+    [SECTION_NULL]           = 0,
+    [SECTION_TEXT]           = 1,
+    [SECTION_SYMTAB]         = 7,
+    [SECTION_STRTAB]         = 15,
+    [SECTION_SHSTRTAB]       = 23,
+    [SECTION_NOTE_GNU_STACK] = 33,
+};
+
+static const char section_name_table[] = "\0.text\0.symtab\0.strtab\0.shstrtab\0.note.GNU-stack";
+
+static void emit_padding(emitter_t* output, size_t start, size_t alignment) {
+    static const char zeros[16] = { 0 };
+    emit_bytes(output, zeros, (alignment - (output->size - start) % alignment) % alignment);
+}
+
+static Elf64_Ehdr make_header(uint16_t type) {
+    Elf64_Ehdr header = {
+        .e_ident = { ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64, ELFDATA2LSB, EV_CURRENT, ELFOSABI_SYSV },
+        .e_type = type,
+        .e_machine = EM_X86_64,
+        .e_version = EV_CURRENT,
+        .e_ehsize = sizeof(Elf64_Ehdr),
+    };
+
+    return header;
+}
+
+static size_t reserve(emitter_t* output, size_t size) {
+    static const char zeros[EXECUTABLE_CODE_OFFSET] = { 0 };
+    size_t start = output->size;
+    emit_bytes(output, zeros, size);
+    return start;
+}
+
+size_t elf64_begin_object(emitter_t* output) {
+    return reserve(output, OBJECT_CODE_OFFSET);
+}
+
+size_t elf64_begin_executable(emitter_t* output) {
+    return reserve(output, EXECUTABLE_CODE_OFFSET);
+}
+
+void elf64_finish_object(emitter_t* output, size_t start, const elf64_symbol_t* symbols, size_t count) {
+    Elf64_Shdr sections[SECTION_COUNT] = { 0 };
+
+    sections[SECTION_TEXT] = (Elf64_Shdr) {
+        .sh_type = SHT_PROGBITS,
+        .sh_flags = SHF_ALLOC | SHF_EXECINSTR,
+        .sh_offset = OBJECT_CODE_OFFSET,
+        .sh_size = output->size - start - OBJECT_CODE_OFFSET,
+        .sh_addralign = 16,
+    };
+
+    // The null symbol is the only local one.
+    emit_padding(output, start, 8);
+    sections[SECTION_SYMTAB] = (Elf64_Shdr) {
+        .sh_type = SHT_SYMTAB,
+        .sh_offset = output->size - start,
+        .sh_size = (count + 1) * sizeof(Elf64_Sym),
+        .sh_link = SECTION_STRTAB,
+        .sh_info = 1,
+        .sh_addralign = 8,
+        .sh_entsize = sizeof(Elf64_Sym),
+    };
+
+    Elf64_Sym null_symbol = { 0 };
+    emit_bytes(output, (const char*) &null_symbol, sizeof(null_symbol));
+
+    uint32_t name = 1;
+    for (size_t i = 0; i < count; i++) {
+        Elf64_Sym symbol = {
+            .st_name = name,
+            .st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC),
+            .st_shndx = SECTION_TEXT,
+            .st_value = symbols[i].offset,
+            .st_size = symbols[i].size,
+        };
+
+        emit_bytes(output, (const char*) &symbol, sizeof(symbol));
+        name += symbols[i].name.size + 1;
+    }
+
+    sections[SECTION_STRTAB] = (Elf64_Shdr) {
+        .sh_type = SHT_STRTAB,
+        .sh_offset = output->size - start,
+        .sh_size = name,
+        .sh_addralign = 1,
+    };
+
+    emit_bytes(output, "", 1);
+    for (size_t i = 0; i < count; i++) {
+        emit_bytes(output, symbols[i].name.data, symbols[i].name.size);
+        emit_bytes(output, "", 1);
+    }
+
+    sections[SECTION_SHSTRTAB] = (Elf64_Shdr) {
+        .sh_type = SHT_STRTAB,
+        .sh_offset = output->size - start,
+        .sh_size = sizeof(section_name_table),
+        .sh_addralign = 1,
+    };
+
+    emit_bytes(output, section_name_table, sizeof(section_name_table));
+
+    // An empty .note.GNU-stack asks the linker for a stack that is not
+    // executable.
+    sections[SECTION_NOTE_GNU_STACK] = (Elf64_Shdr) {
+        .sh_type = SHT_PROGBITS,
+        .sh_offset = output->size - start,
+        .sh_addralign = 1,
+    };
+
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        sections[i].sh_name = section_names[i];
+    }
+
+    emit_padding(output, start, 8);
+    size_t section_offset = output->size - start;
+    emit_bytes(output, (const char*) sections, sizeof(sections));
+
+    Elf64_Ehdr header = make_header(ET_REL);
+    header.e_shoff = section_offset;
+    header.e_shentsize = sizeof(Elf64_Shdr);
+    header.e_shnum = SECTION_COUNT;
+    header.e_shstrndx = SECTION_SHSTRTAB;
+
+    memcpy(output->data + start, &header, sizeof(header));
+}
+
+void elf64_finish_executable(emitter_t* output, size_t start, uint32_t entry) {
+    size_t size = output->size - start;
+
+    Elf64_Phdr segments[EXECUTABLE_HEADERS] = {
+        {
+            .p_type = PT_LOAD,
+            .p_flags = PF_R | PF_X,
+            .p_vaddr = EXECUTABLE_BASE,
+            .p_paddr = EXECUTABLE_BASE,
+            .p_filesz = size,
+            .p_memsz = size,
+            .p_align = 0x1000,
+        },
+        {
+            .p_type = PT_GNU_STACK,
+            .p_flags = PF_R | PF_W,
+            .p_align = 16,
+        },
+    };
+
+    Elf64_Ehdr header = make_header(ET_EXEC);
+    header.e_entry = EXECUTABLE_BASE + EXECUTABLE_CODE_OFFSET + entry;
+    header.e_phoff = sizeof(Elf64_Ehdr);
+    header.e_phentsize = sizeof(Elf64_Phdr);
+    header.e_phnum = EXECUTABLE_HEADERS;
+
+    memcpy(output->data + start, &header, sizeof(header));
+    memcpy(output->data + start + sizeof(header), segments, sizeof(segments));
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <emitter.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sv/sv.h>
+
+// A function in the machine code of an ELF file, relative to the code's
+// start.
+typedef struct {
+    sv_t name;
+    uint32_t offset;
+    uint32_t size;
+} elf64_symbol_t;
+
+// The headers go in front of the code, so they are reserved before it is
+// appended and filled in once it is all there. Both return where the file
+// starts in the emitter.
+size_t elf64_begin_object(emitter_t*);
+size_t elf64_begin_executable(emitter_t*);
+
+// Adds a global function symbol for each entry after the code, and the
+// sections describing it all.
+void elf64_finish_object(emitter_t*, size_t, const elf64_symbol_t*, size_t);
+
+// A single segment maps the whole file; `entry` is an offset into the code.
+void elf64_finish_executable(emitter_t*, size_t, uint32_t);
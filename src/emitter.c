@@ -0,0 +1,149 @@
+#include <alloc.h>
+#include <common.h>
+#include <emitter.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define EMITTER_INITIAL_CAPACITY 4096
+
+// Longest int64_t, with its sign.
+#define INTEGER_MAX_DIGITS 20
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+void emitter_init(emitter_t* emitter) {
+    emitter->data = NULL;
+    emitter->size = 0;
+    emitter->capacity = 0;
+    emitter->tag = MEM_OUTPUT;
+}
+
+void emitter_deinit(emitter_t* emitter) {
+    mem_free(emitter->data);
+}
+
+void emitter_clear(emitter_t* emitter) {
+    emitter->size = 0;
+}
+
+static void reserve(emitter_t* emitter, size_t size) {
+    if (emitter->size + size <= emitter->capacity) {
+        return;
+    }
+
+    size_t capacity = emitter->capacity ? emitter->capacity : EMITTER_INITIAL_CAPACITY;
+    while (capacity < emitter->size + size) {
+        capacity *= 2;
+    }
+
+    mem_tag_t tag = mem_set_tag(emitter->tag);
+    char* data = mem_alloc(capacity);
+    mem_set_tag(tag);
+    if (emitter->size > 0) {
+        memcpy(data, emitter->data, emitter->size);
+    }
+
+    mem_free(emitter->data);
+    emitter->data = data;
+    emitter->capacity = capacity;
+}
+
+void emit_bytes(emitter_t* emitter, const char* bytes, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    reserve(emitter, size);
+    memcpy(emitter->data + emitter->size, bytes, size);
+    emitter->size += size;
+}
+
+void emit_string(emitter_t* emitter, const char* string) {
+    emit_bytes(emitter, string, strlen(string));
+}
+
+// Digits are produced two at a time from the end.
+void emit_integer(emitter_t* emitter, int64_t value) {
+    char buffer[INTEGER_MAX_DIGITS];
+    char* end = buffer + sizeof(buffer);
+    char* cursor = end;
+
+    uint64_t magnitude = value < 0 ? -(uint64_t) value : (uint64_t) value;
+
+    while (magnitude >= 100) {
+        const char* pair = &digit_pairs[(magnitude % 100) * 2];
+        magnitude /= 100;
+        *--cursor = pair[1];
+        *--cursor = pair[0];
+    }
+
+    if (magnitude >= 10) {
+        const char* pair = &digit_pairs[magnitude * 2];
+        *--cursor = pair[1];
+        *--cursor = pair[0];
+    } else {
+        *--cursor = '0' + magnitude;
+    }
+
+    if (value < 0) {
+        *--cursor = '-';
+    }
+
+    emit_bytes(emitter, cursor, end - cursor);
+}
+
+void emitf(emitter_t* emitter, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    const char* run = format;
+    const char* cursor = format;
+
+    while (*cursor) {
+        if (*cursor != '%') {
+            cursor++;
+            continue;
+        }
+
+        emit_bytes(emitter, run, cursor - run);
+        cursor++;
+
+        if (cursor[0] == 's') {
+            emit_string(emitter, va_arg(args, const char*));
+            cursor += 1;
+        } else if (cursor[0] == 'd') {
+            emit_integer(emitter, va_arg(args, int));
+            cursor += 1;
+        } else if (cursor[0] == 'l' && cursor[1] == 'd') {
+            emit_integer(emitter, va_arg(args, long));
+            cursor += 2;
+        } else if (cursor[0] == '.' && cursor[1] == '*' && cursor[2] == 's') {
+            int size = va_arg(args, int);
+            emit_bytes(emitter, va_arg(args, const char*), size);
+            cursor += 3;
+        } else {
+            emit_bytes(emitter, "%", 1);
+            cursor += cursor[0] == '%';
+        }
+
+        run = cursor;
+    }
+
+    emit_bytes(emitter, run, cursor - run);
+
+    va_end(args);
+}
+
+bool emitter_write(emitter_t* emitter, int fd) {
+    return write_all(fd, emitter->data, emitter->size);
+}
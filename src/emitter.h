@@ -0,0 +1,33 @@
+#pragma once
+
+#include <alloc.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A growable buffer that assembly is formatted into. Integers and strings
+// are formatted by hand, since going through stdio for every instruction
+// costs more than generating it. Its memory is charged to `tag`, which is
+// MEM_OUTPUT unless the owner sets another.
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+    mem_tag_t tag;
+} emitter_t;
+
+void emitter_init(emitter_t*);
+void emitter_deinit(emitter_t*);
+
+// Empties the buffer but keeps its memory.
+void emitter_clear(emitter_t*);
+
+void emit_bytes(emitter_t*, const char*, size_t);
+void emit_string(emitter_t*, const char*);
+void emit_integer(emitter_t*, int64_t);
+
+// Understands %s, %d, %ld, %.*s, so SV_FMT works, and %%.
+void emitf(emitter_t*, const char*, ...);
+
+// Writes the whole buffer to a file descriptor.
+bool emitter_write(emitter_t*, int);
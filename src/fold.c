@@ -0,0 +1,328 @@
+#include <alloc.h>
+#include <fold.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// `forward` maps each node to the node that now computes its value, which
+// is itself unless it was simplified to one of its operands. `impure` marks
+// subtrees that contain a call or a division that may trap, and so cannot
+// be dropped.
+typedef struct {
+    compiler_t* compiler;
+    ast_t* ast;
+    node_id_t first;
+
+    node_id_t* forward;
+    bool* impure;
+} fold_t;
+
+static node_id_t* forward_of(fold_t* fold, node_id_t id) {
+    return &fold->forward[id - fold->first];
+}
+
+static bool* impure_of(fold_t* fold, node_id_t id) {
+    return &fold->impure[id - fold->first];
+}
+
+static bool is_literal(node_t* node) {
+    return node->kind == NODE_INTEGER || node->kind == NODE_FLOATING || node->kind == NODE_BOOLEAN;
+}
+
+static bool is_integer(node_t* node, int64_t value) {
+    return node->kind == NODE_INTEGER && node->as.integer == value;
+}
+
+static bool is_boolean(node_t* node, bool value) {
+    return node->kind == NODE_BOOLEAN && node->as.boolean == value;
+}
+
+static bool is_zero(node_t* node) {
+    return is_integer(node, 0) || (node->kind == NODE_FLOATING && node->as.floating == 0.0);
+}
+
+// Operands are already folded, so a dropped subtree only holds nodes that
+// are still live.
+static void drop(ast_t* ast, node_id_t id) {
+    node_t* node = ast_node(ast, id);
+
+    switch (node->kind) {
+        case NODE_BINARY:
+            drop(ast, node->as.pair.lhs);
+            drop(ast, node->as.pair.rhs);
+            break;
+        case NODE_FUNCALL:
+            for (uint32_t i = 0; i < node->as.range.count; i++) {
+                drop(ast, ast_child(ast, node->as.range, i));
+            }
+            break;
+        default:
+            break;
+    }
+
+    node->kind = NODE_FOLDED;
+}
+
+static void make_integer(node_t* node, int64_t value) {
+    node->kind = NODE_INTEGER;
+    node->as.integer = value;
+}
+
+static void make_floating(node_t* node, double value) {
+    node->kind = NODE_FLOATING;
+    node->as.floating = value;
+}
+
+static void make_boolean(node_t* node, bool value) {
+    node->kind = NODE_BOOLEAN;
+    node->as.boolean = value;
+}
+
+// Arithmetic wraps like the emitted instructions do. Dividing INT64_MIN by
+// -1 traps at run time, so it is left for run time.
+static bool fold_integers(node_t* binary, int64_t lhs, int64_t rhs) {
+    switch (binary->op) {
+        case BINARY_ADD:
+            make_integer(binary, (int64_t) ((uint64_t) lhs + (uint64_t) rhs));
+            return true;
+        case BINARY_SUB:
+            make_integer(binary, (int64_t) ((uint64_t) lhs - (uint64_t) rhs));
+            return true;
+        case BINARY_MUL:
+            make_integer(binary, (int64_t) ((uint64_t) lhs * (uint64_t) rhs));
+            return true;
+        case BINARY_DIV:
+            if (lhs == INT64_MIN && rhs == -1) {
+                return false;
+            }
+            make_integer(binary, lhs / rhs);
+            return true;
+        case BINARY_EQUAL:
+            make_boolean(binary, lhs == rhs);
+            return true;
+        case BINARY_NOT_EQUAL:
+            make_boolean(binary, lhs != rhs);
+            return true;
+        case BINARY_LESS:
+            make_boolean(binary, lhs < rhs);
+            return true;
+        case BINARY_GREATER:
+            make_boolean(binary, lhs > rhs);
+            return true;
+        case BINARY_LESS_EQUAL:
+            make_boolean(binary, lhs <= rhs);
+            return true;
+        case BINARY_GREATER_EQUAL:
+            make_boolean(binary, lhs >= rhs);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool fold_floats(node_t* binary, double lhs, double rhs) {
+    switch (binary->op) {
+        case BINARY_ADD:
+            make_floating(binary, lhs + rhs);
+            return true;
+        case BINARY_SUB:
+            make_floating(binary, lhs - rhs);
+            return true;
+        case BINARY_MUL:
+            make_floating(binary, lhs * rhs);
+            return true;
+        case BINARY_DIV:
+            make_floating(binary, lhs / rhs);
+            return true;
+        case BINARY_EQUAL:
+            make_boolean(binary, lhs == rhs);
+            return true;
+        case BINARY_NOT_EQUAL:
+            make_boolean(binary, lhs != rhs);
+            return true;
+        case BINARY_LESS:
+            make_boolean(binary, lhs < rhs);
+            return true;
+        case BINARY_GREATER:
+            make_boolean(binary, lhs > rhs);
+            return true;
+        case BINARY_LESS_EQUAL:
+            make_boolean(binary, lhs <= rhs);
+            return true;
+        case BINARY_GREATER_EQUAL:
+            make_boolean(binary, lhs >= rhs);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool fold_booleans(node_t* binary, bool lhs, bool rhs) {
+    switch (binary->op) {
+        case BINARY_EQUAL:
+            make_boolean(binary, lhs == rhs);
+            return true;
+        case BINARY_NOT_EQUAL:
+            make_boolean(binary, lhs != rhs);
+            return true;
+        case BINARY_AND:
+            make_boolean(binary, lhs && rhs);
+            return true;
+        case BINARY_OR:
+            make_boolean(binary, lhs || rhs);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool fold_literals(node_t* binary, node_t* lhs, node_t* rhs) {
+    switch (lhs->kind) {
+        case NODE_INTEGER:
+            return fold_integers(binary, lhs->as.integer, rhs->as.integer);
+        case NODE_FLOATING:
+            return fold_floats(binary, lhs->as.floating, rhs->as.floating);
+        case NODE_BOOLEAN:
+            return fold_booleans(binary, lhs->as.boolean, rhs->as.boolean);
+        default:
+            return false;
+    }
+}
+
+// `x op identity` is x. Only integer and boolean identities are applied;
+// float ones do not hold for every value (-0.0 + 0.0 is 0.0).
+static bool is_right_identity(binary_op_t op, node_t* operand) {
+    switch (op) {
+        case BINARY_ADD:
+        case BINARY_SUB:
+            return is_integer(operand, 0);
+        case BINARY_MUL:
+        case BINARY_DIV:
+            return is_integer(operand, 1);
+        case BINARY_AND:
+            return is_boolean(operand, true);
+        case BINARY_OR:
+            return is_boolean(operand, false);
+        default:
+            return false;
+    }
+}
+
+static bool is_left_identity(binary_op_t op, node_t* operand) {
+    return op != BINARY_SUB && op != BINARY_DIV && is_right_identity(op, operand);
+}
+
+// `x op absorbing` is the absorbing operand whatever x is.
+static bool is_absorbing(binary_op_t op, node_t* operand) {
+    switch (op) {
+        case BINARY_MUL:
+            return is_integer(operand, 0);
+        case BINARY_AND:
+            return is_boolean(operand, false);
+        case BINARY_OR:
+            return is_boolean(operand, true);
+        default:
+            return false;
+    }
+}
+
+// Division traps on a zero divisor and on INT64_MIN / -1, so only a
+// constant divisor other than those is known not to.
+static bool may_trap(binary_op_t op, node_t* rhs) {
+    return op == BINARY_DIV && rhs->kind != NODE_FLOATING && (rhs->kind != NODE_INTEGER || rhs->as.integer == -1);
+}
+
+static compile_error_t fold_binary(fold_t* fold, node_id_t id) {
+    ast_t* ast = fold->ast;
+    node_t* binary = ast_node(ast, id);
+
+    binary->as.pair.lhs = *forward_of(fold, binary->as.pair.lhs);
+    binary->as.pair.rhs = *forward_of(fold, binary->as.pair.rhs);
+
+    node_id_t lhs_id = binary->as.pair.lhs;
+    node_id_t rhs_id = binary->as.pair.rhs;
+    node_t* lhs = ast_node(ast, lhs_id);
+    node_t* rhs = ast_node(ast, rhs_id);
+
+    *impure_of(fold, id) = *impure_of(fold, lhs_id) || *impure_of(fold, rhs_id) || may_trap(binary->op, rhs);
+
+    if (binary->op == BINARY_DIV && is_zero(rhs)) {
+        fprintf(fold->compiler->diagnostics, LOCATION_FMT" ERROR: division by zero\n", LOCATION_ARG(ast_location(ast, id)));
+        return COMP_ERROR_DIVISION_BY_ZERO;
+    }
+
+    if (is_literal(lhs) && is_literal(rhs)) {
+        if (fold_literals(binary, lhs, rhs)) {
+            lhs->kind = NODE_FOLDED;
+            rhs->kind = NODE_FOLDED;
+        }
+    } else if (is_right_identity(binary->op, rhs)) {
+        *forward_of(fold, id) = lhs_id;
+        rhs->kind = NODE_FOLDED;
+        binary->kind = NODE_FOLDED;
+    } else if (is_left_identity(binary->op, lhs)) {
+        *forward_of(fold, id) = rhs_id;
+        lhs->kind = NODE_FOLDED;
+        binary->kind = NODE_FOLDED;
+    } else if (is_absorbing(binary->op, rhs) && !*impure_of(fold, lhs_id)) {
+        binary->kind = rhs->kind;
+        binary->as = rhs->as;
+        drop(ast, lhs_id);
+        rhs->kind = NODE_FOLDED;
+    } else if (is_absorbing(binary->op, lhs) && !*impure_of(fold, rhs_id)) {
+        binary->kind = lhs->kind;
+        binary->as = lhs->as;
+        drop(ast, rhs_id);
+        lhs->kind = NODE_FOLDED;
+    }
+
+    return COMP_ERROR_OK;
+}
+
+// Nodes are visited in post-order, so operands are final by the time their
+// parent is folded and references only ever need forwarding one step.
+compile_error_t fold_function_definition(compiler_t* compiler, ast_t* ast, node_id_t fundef) {
+    node_id_t first = ast_function_first(ast, fundef);
+
+    fold_t fold = {
+        .compiler = compiler,
+        .ast = ast,
+        .first = first,
+        .forward = mem_alloc(sizeof(node_id_t) * (fundef - first + 1)),
+        .impure = mem_calloc(fundef - first + 1, sizeof(bool)),
+    };
+
+    compile_error_t error = COMP_ERROR_OK;
+
+    for (node_id_t id = first; id < fundef && error == COMP_ERROR_OK; id++) {
+        node_t* node = ast_node(ast, id);
+        *forward_of(&fold, id) = id;
+
+        switch (node->kind) {
+            case NODE_BINARY:
+                error = fold_binary(&fold, id);
+                break;
+            case NODE_FUNCALL:
+                for (uint32_t i = 0; i < node->as.range.count; i++) {
+                    node_id_t* argument = &ast->lists[node->as.range.first + i];
+                    *argument = *forward_of(&fold, *argument);
+                }
+                *impure_of(&fold, id) = true;
+                break;
+            case NODE_LET_ASSIGNMENT:
+                node->as.pair.rhs = *forward_of(&fold, node->as.pair.rhs);
+                break;
+            case NODE_RETURN:
+                if (node->as.pair.lhs != NODE_NONE) {
+                    node->as.pair.lhs = *forward_of(&fold, node->as.pair.lhs);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    mem_free(fold.forward);
+    mem_free(fold.impure);
+
+    return error;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <compiler.h>
+
+// Folds binary expressions over literals and simplifies identities such as
+// `x * 1` and `b and true`, rewriting the function's nodes in place. Runs
+// after the body is checked; dropped nodes become NODE_FOLDED.
+compile_error_t fold_function_definition(compiler_t*, ast_t*, node_id_t);
@@ -0,0 +1,114 @@
+#include <alloc.h>
+#include <dynarray/dynarray.h>
+#include <interner.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERNER_INITIAL_CAPACITY 1024
+
+static const char* builtin_names[SYMBOL_BUILTIN_COUNT] = {
+    [SYMBOL_INT]   = "int",
+    [SYMBOL_FLOAT] = "float",
+    [SYMBOL_BOOL]  = "bool",
+    [SYMBOL_VOID]  = "void",
+    [SYMBOL_MAIN]  = "main",
+};
+
+// FNV-1a.
+static uint32_t hash_name(sv_t name) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < name.size; i++) {
+        hash ^= (unsigned char) name.data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static symbol_t* allocate_slots(size_t capacity) {
+    symbol_t* slots = mem_alloc(sizeof(symbol_t) * capacity);
+    memset(slots, 0xFF, sizeof(symbol_t) * capacity);
+
+    return slots;
+}
+
+void interner_init(interner_t* interner) {
+    arena_init(&interner->arena);
+
+    interner->names = dynarray_create(sv_t);
+    interner->hashes = dynarray_create(uint32_t);
+
+    interner->capacity = INTERNER_INITIAL_CAPACITY;
+    interner->slots = allocate_slots(interner->capacity);
+
+    for (int i = 0; i < SYMBOL_BUILTIN_COUNT; i++) {
+        interner_intern(interner, sv_make_from(builtin_names[i]));
+    }
+}
+
+void interner_deinit(interner_t* interner) {
+    mem_free(interner->slots);
+    dynarray_destroy(interner->hashes);
+    dynarray_destroy(interner->names);
+    arena_deinit(&interner->arena);
+}
+
+static void grow(interner_t* interner) {
+    size_t capacity = interner->capacity * 2;
+    symbol_t* slots = allocate_slots(capacity);
+
+    for (symbol_t symbol = 0; symbol < dynarray_length(interner->names); symbol++) {
+        size_t slot = interner->hashes[symbol] & (capacity - 1);
+        while (slots[slot] != SYMBOL_NONE) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+
+        slots[slot] = symbol;
+    }
+
+    mem_free(interner->slots);
+    interner->slots = slots;
+    interner->capacity = capacity;
+}
+
+symbol_t interner_intern(interner_t* interner, sv_t name) {
+    uint32_t hash = hash_name(name);
+    size_t slot = hash & (interner->capacity - 1);
+
+    while (interner->slots[slot] != SYMBOL_NONE) {
+        symbol_t symbol = interner->slots[slot];
+        sv_t existing = interner->names[symbol];
+
+        if (interner->hashes[symbol] == hash && existing.size == name.size && memcmp(existing.data, name.data, name.size) == 0) {
+            return symbol;
+        }
+
+        slot = (slot + 1) & (interner->capacity - 1);
+    }
+
+    symbol_t symbol = dynarray_length(interner->names);
+    mem_tag_t tag = mem_set_tag(MEM_SYMBOLS);
+
+    char* copy = arena_alloc(&interner->arena, name.size);
+    memcpy(copy, name.data, name.size);
+
+    dynarray_push_rval(interner->names, sv_make(copy, name.size));
+    dynarray_push_rval(interner->hashes, hash);
+    interner->slots[slot] = symbol;
+
+    // Kept at most half full so probe sequences stay short.
+    if (dynarray_length(interner->names) * 2 > interner->capacity) {
+        grow(interner);
+    }
+
+    mem_set_tag(tag);
+    return symbol;
+}
+
+sv_t interner_name(interner_t* interner, symbol_t symbol) {
+    return interner->names[symbol];
+}
+
+size_t interner_count(interner_t* interner) {
+    return dynarray_length(interner->names);
+}
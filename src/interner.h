@@ -0,0 +1,41 @@
+#pragma once
+
+#include <arena/arena.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sv/sv.h>
+
+// Every distinct identifier gets a dense id, so names compare as integers.
+typedef uint32_t symbol_t;
+
+#define SYMBOL_NONE UINT32_MAX
+
+// Interned first, in this order, so their ids are known constants.
+typedef enum {
+    SYMBOL_INT,
+    SYMBOL_FLOAT,
+    SYMBOL_BOOL,
+    SYMBOL_VOID,
+    SYMBOL_MAIN,
+    SYMBOL_BUILTIN_COUNT,
+} builtin_symbol_t;
+
+// Names are copied into the arena so they outlive the buffer they were
+// lexed from. The table is open-addressed and holds ids, with the hashes
+// kept alongside the names so growing it never rehashes a string.
+typedef struct {
+    arena_t arena;
+
+    sv_t* names;
+    uint32_t* hashes;
+
+    symbol_t* slots;
+    size_t capacity;
+} interner_t;
+
+void interner_init(interner_t*);
+void interner_deinit(interner_t*);
+
+symbol_t interner_intern(interner_t*, sv_t);
+sv_t interner_name(interner_t*, symbol_t);
+size_t interner_count(interner_t*);
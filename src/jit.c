@@ -0,0 +1,56 @@
+#include <errno.h>
+#include <jit.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// perf reads the map once the process is gone, so it is left in place. It
+// only helps profiling, so failing to write it is not an error.
+static void write_perf_map(jit_t* jit, const elf64_symbol_t* symbols, size_t count) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int) getpid());
+
+    FILE* map = fopen(path, "w");
+    if (!map) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        fprintf(map, "%lx %x "SV_FMT"\n", (unsigned long) (jit->memory + symbols[i].offset), symbols[i].size, SV_ARG(symbols[i].name));
+    }
+
+    fclose(map);
+}
+
+bool jit_load(jit_t* jit, const char* code, size_t size, uint32_t main, const elf64_symbol_t* symbols, size_t count) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    jit->size = (size + page - 1) / page * page;
+    jit->memory = mmap(NULL, jit->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (jit->memory == MAP_FAILED) {
+        fprintf(stderr, "ERROR: cannot map %zu bytes of code: %s\n", jit->size, strerror(errno));
+        return false;
+    }
+
+    memcpy(jit->memory, code, size);
+
+    if (mprotect(jit->memory, jit->size, PROT_READ | PROT_EXEC) != 0) {
+        fprintf(stderr, "ERROR: cannot make code executable: %s\n", strerror(errno));
+        munmap(jit->memory, jit->size);
+        return false;
+    }
+
+    jit->main = (int64_t (*)(void)) (jit->memory + main);
+    write_perf_map(jit, symbols, count);
+
+    return true;
+}
+
+void jit_unload(jit_t* jit) {
+    munmap(jit->memory, jit->size);
+}
+
+int64_t jit_run(jit_t* jit) {
+    return jit->main();
+}
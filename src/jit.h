@@ -0,0 +1,21 @@
+#pragma once
+
+#include <elf64.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Linked machine code mapped into the compiler's own process.
+typedef struct {
+    char* memory;
+    size_t size;
+    int64_t (*main)(void);
+} jit_t;
+
+// Copies the code into fresh pages, which are then made executable and no
+// longer writable, and lists every function in /tmp/perf-<pid>.map so perf
+// can name them. `main` is the offset of the function jit_run calls.
+bool jit_load(jit_t*, const char*, size_t, uint32_t, const elf64_symbol_t*, size_t);
+void jit_unload(jit_t*);
+
+int64_t jit_run(jit_t*);
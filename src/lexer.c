@@ -1,234 +1,685 @@
-#include <ctype.h>
+#include <alloc.h>
 #include <dynarray/dynarray.h>
 #include <lexer.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 static char current(lexer_t* lexer) {
-    return lexer->input[lexer->cursor];
+    return *lexer->cursor;
 }
 
 static bool is_eof(lexer_t* lexer) {
-    return lexer->input == NULL || current(lexer) == 0;
+    return lexer->cursor >= lexer->end;
 }
 
-static void advance(lexer_t* lexer) {
-    if (is_eof(lexer)) {
-        return;
+static void add_line(lexer_t* lexer, const char* line_start) {
+    dynarray_push_rval(lexer->line_starts, (uint64_t) (line_start - lexer->input));
+}
+
+static bool is_whitespace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+#if !defined(LEXER_NO_SIMD) && defined(__AVX2__)
+#define LEXER_SIMD_WIDTH 32
+
+static uint32_t simd_byte_mask(const char* p, char c) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i*) p);
+    return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(c)));
+}
+
+static uint32_t simd_whitespace_mask(const char* p) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i*) p);
+    __m256i space = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' '));
+
+    // '\t'..'\r' are contiguous, so one unsigned range check covers them.
+    __m256i ctrl = _mm256_sub_epi8(chunk, _mm256_set1_epi8('\t'));
+    ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(ctrl, _mm256_set1_epi8('\r' - '\t')), ctrl);
+
+    return (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(space, ctrl));
+}
+#elif !defined(LEXER_NO_SIMD) && defined(__SSE2__)
+#define LEXER_SIMD_WIDTH 16
+
+static uint32_t simd_byte_mask(const char* p, char c) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*) p);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c)));
+}
+
+static uint32_t simd_whitespace_mask(const char* p) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*) p);
+    __m128i space = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+
+    // '\t'..'\r' are contiguous, so one unsigned range check covers them.
+    __m128i ctrl = _mm_sub_epi8(chunk, _mm_set1_epi8('\t'));
+    ctrl = _mm_cmpeq_epi8(_mm_min_epu8(ctrl, _mm_set1_epi8('\r' - '\t')), ctrl);
+
+    return (uint32_t) _mm_movemask_epi8(_mm_or_si128(space, ctrl));
+}
+#endif
+
+#ifdef LEXER_SIMD_WIDTH
+#define LEXER_SIMD_FULL_MASK ((uint32_t) ((1ull << LEXER_SIMD_WIDTH) - 1))
+
+// Moves the cursor over `n` bytes whose newlines are marked in `newlines`.
+static void advance_chunk(lexer_t* lexer, int n, uint32_t newlines) {
+    while (newlines) {
+        add_line(lexer, lexer->cursor + __builtin_ctz(newlines) + 1);
+        newlines &= newlines - 1;
     }
 
-    if (current(lexer) == '\n') {
-        lexer->line++;
-        lexer->col = 1;
-    } else {
-        lexer->col++;
+    lexer->cursor += n;
+}
+#endif
+
+static void skip_whitespace(lexer_t* lexer) {
+#ifdef LEXER_SIMD_WIDTH
+    while (!lexer->scalar && lexer->end - lexer->cursor >= LEXER_SIMD_WIDTH) {
+        const char* p = lexer->cursor;
+        uint32_t stop = ~simd_whitespace_mask(p) & LEXER_SIMD_FULL_MASK;
+        int n = stop ? __builtin_ctz(stop) : LEXER_SIMD_WIDTH;
+
+        uint32_t newlines = simd_byte_mask(p, '\n');
+        if (n < LEXER_SIMD_WIDTH) {
+            newlines &= (1u << n) - 1;
+        }
+
+        advance_chunk(lexer, n, newlines);
+
+        if (stop) {
+            return;
+        }
     }
+#endif
+
+    while (!is_eof(lexer) && is_whitespace(current(lexer))) {
+        if (current(lexer) == '\n') {
+            add_line(lexer, lexer->cursor + 1);
+        }
 
-    lexer->cursor++;
+        lexer->cursor++;
+    }
 }
 
-static void skip_ws_and_comments(lexer_t* lexer) {
-    while (!is_eof(lexer) && (isspace(current(lexer)) || current(lexer) == '#')) {
-        while (!is_eof(lexer) && isspace(current(lexer))) {
-            advance(lexer);
+// Skips up to, but not including, the newline that ends the comment.
+static void skip_comment(lexer_t* lexer) {
+#ifdef LEXER_SIMD_WIDTH
+    while (!lexer->scalar && lexer->end - lexer->cursor >= LEXER_SIMD_WIDTH) {
+        uint32_t newlines = simd_byte_mask(lexer->cursor, '\n');
+        if (newlines) {
+            advance_chunk(lexer, __builtin_ctz(newlines), 0);
+            return;
         }
 
-        if (current(lexer) == '#') {
-            do {
-                advance(lexer);
-            } while (!is_eof(lexer) && current(lexer) != '\n');
+        advance_chunk(lexer, LEXER_SIMD_WIDTH, 0);
+    }
+#endif
+
+    while (!is_eof(lexer) && current(lexer) != '\n') {
+        lexer->cursor++;
+    }
+}
+
+static void skip_ws_and_comments(lexer_t* lexer) {
+    while (!is_eof(lexer)) {
+        if (is_whitespace(current(lexer))) {
+            skip_whitespace(lexer);
+        } else if (current(lexer) == '#') {
+            skip_comment(lexer);
+        } else {
+            break;
         }
     }
 }
 
-void lexer_init(lexer_t* lexer, char* input) {
+void lexer_init(lexer_t* lexer, const char* input, size_t size) {
     lexer->input  = input;
-    lexer->cursor = 0;
-    lexer->line   = 1;
-    lexer->col    = 1;
+    lexer->end    = input + size;
+    lexer->cursor = input;
+
+    lexer->line_starts = dynarray_create(uint64_t);
+    lexer->quiet       = false;
+    lexer->scalar      = false;
+    lexer->interner    = NULL;
+    lexer->diagnostics = stderr;
+    dynarray_push_rval(lexer->line_starts, (uint64_t) 0);
 }
 
 void lexer_deinit(lexer_t* lexer) {
-    if (lexer->input) {
-        free(lexer->input);
+    dynarray_destroy(lexer->line_starts);
+
+    lexer->input  = NULL;
+    lexer->end    = NULL;
+    lexer->cursor = NULL;
+}
+
+location_t lexer_location(lexer_t* lexer, uint64_t offset) {
+    uint64_t* starts = lexer->line_starts;
+
+    size_t lo = 0;
+    size_t hi = dynarray_length(starts);
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (starts[mid] <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
     }
+
+    return location_make(lo + 1, offset - starts[lo] + 1);
 }
 
-token_t* get_tokens(lexer_t* lexer) {
-    token_t* tokens = dynarray_create(token_t);
+typedef enum {
+    CHAR_OTHER,
+    CHAR_SPACE,
+    CHAR_DIGIT,
+    CHAR_IDENT,
+    CHAR_DOT,
+    CHAR_EQUAL,
+    CHAR_BANG,
+    CHAR_LESS,
+    CHAR_GREATER,
+    CHAR_SINGLE,
+    CHAR_CLASS_COUNT,
+} char_class_t;
 
-    while (true) {
-        skip_ws_and_comments(lexer);
+static const uint8_t char_classes[256] = {
+    [' ']           = CHAR_SPACE,
+    ['\t' ... '\r'] = CHAR_SPACE,
+    ['0' ... '9']   = CHAR_DIGIT,
+    ['a' ... 'z']   = CHAR_IDENT,
+    ['A' ... 'Z']   = CHAR_IDENT,
+    ['_']           = CHAR_IDENT,
+    ['.']           = CHAR_DOT,
+    ['=']           = CHAR_EQUAL,
+    ['!']           = CHAR_BANG,
+    ['<']           = CHAR_LESS,
+    ['>']           = CHAR_GREATER,
+    ['(']           = CHAR_SINGLE,
+    [')']           = CHAR_SINGLE,
+    ['{']           = CHAR_SINGLE,
+    ['}']           = CHAR_SINGLE,
+    [':']           = CHAR_SINGLE,
+    [',']           = CHAR_SINGLE,
+    [';']           = CHAR_SINGLE,
+    ['+']           = CHAR_SINGLE,
+    ['-']           = CHAR_SINGLE,
+    ['*']           = CHAR_SINGLE,
+    ['/']           = CHAR_SINGLE,
+};
+
+static const uint8_t single_char_kinds[256] = {
+    ['('] = TOK_LPAREN,
+    [')'] = TOK_RPAREN,
+    ['{'] = TOK_LCURLY,
+    ['}'] = TOK_RCURLY,
+    [':'] = TOK_COLON,
+    [','] = TOK_COMMA,
+    [';'] = TOK_SEMICOLON,
+    ['+'] = TOK_PLUS,
+    ['-'] = TOK_MINUS,
+    ['*'] = TOK_STAR,
+    ['/'] = TOK_SLASH,
+};
+
+// STATE_DONE is zero so every transition left out of the table ends the token.
+typedef enum {
+    STATE_DONE,
+    STATE_START,
+    STATE_IDENT,
+    STATE_INT,
+    STATE_FLOAT_DOT,
+    STATE_FLOAT,
+    STATE_EQUAL,
+    STATE_EQUAL_EQUAL,
+    STATE_BANG,
+    STATE_BANG_EQUAL,
+    STATE_LESS,
+    STATE_LESS_EQUAL,
+    STATE_GREATER,
+    STATE_GREATER_EQUAL,
+    STATE_SINGLE,
+    STATE_GARBAGE,
+    STATE_COUNT,
+} lex_state_t;
+
+static const uint8_t transitions[STATE_COUNT][CHAR_CLASS_COUNT] = {
+    [STATE_START] = {
+        [CHAR_OTHER]   = STATE_GARBAGE,
+        [CHAR_DIGIT]   = STATE_INT,
+        [CHAR_IDENT]   = STATE_IDENT,
+        [CHAR_DOT]     = STATE_GARBAGE,
+        [CHAR_EQUAL]   = STATE_EQUAL,
+        [CHAR_BANG]    = STATE_BANG,
+        [CHAR_LESS]    = STATE_LESS,
+        [CHAR_GREATER] = STATE_GREATER,
+        [CHAR_SINGLE]  = STATE_SINGLE,
+    },
+    [STATE_IDENT] = {
+        [CHAR_DIGIT] = STATE_IDENT,
+        [CHAR_IDENT] = STATE_IDENT,
+    },
+    [STATE_INT] = {
+        [CHAR_DIGIT] = STATE_INT,
+        [CHAR_DOT]   = STATE_FLOAT_DOT,
+    },
+    [STATE_FLOAT_DOT] = {
+        [CHAR_DIGIT] = STATE_FLOAT,
+    },
+    [STATE_FLOAT] = {
+        [CHAR_DIGIT] = STATE_FLOAT,
+    },
+    [STATE_EQUAL] = {
+        [CHAR_EQUAL] = STATE_EQUAL_EQUAL,
+    },
+    [STATE_BANG] = {
+        [CHAR_EQUAL] = STATE_BANG_EQUAL,
+    },
+    [STATE_LESS] = {
+        [CHAR_EQUAL] = STATE_LESS_EQUAL,
+    },
+    [STATE_GREATER] = {
+        [CHAR_EQUAL] = STATE_GREATER_EQUAL,
+    },
+    [STATE_GARBAGE] = {
+        [CHAR_OTHER]   = STATE_GARBAGE,
+        [CHAR_DIGIT]   = STATE_GARBAGE,
+        [CHAR_IDENT]   = STATE_GARBAGE,
+        [CHAR_DOT]     = STATE_GARBAGE,
+        [CHAR_EQUAL]   = STATE_GARBAGE,
+        [CHAR_BANG]    = STATE_GARBAGE,
+        [CHAR_LESS]    = STATE_GARBAGE,
+        [CHAR_GREATER] = STATE_GARBAGE,
+        [CHAR_SINGLE]  = STATE_GARBAGE,
+    },
+};
+
+static const token_kind_t accepting_kinds[STATE_COUNT] = {
+    [STATE_IDENT]         = TOK_IDENTIFIER,
+    [STATE_INT]           = TOK_INTLITERAL,
+    [STATE_FLOAT_DOT]     = TOK_GARBAGE,
+    [STATE_FLOAT]         = TOK_FLOATLITERAL,
+    [STATE_EQUAL]         = TOK_EQUAL,
+    [STATE_EQUAL_EQUAL]   = TOK_EQUAL_EQUAL,
+    [STATE_BANG]          = TOK_BANG,
+    [STATE_BANG_EQUAL]    = TOK_BANG_EQUAL,
+    [STATE_LESS]          = TOK_LESS,
+    [STATE_LESS_EQUAL]    = TOK_LESS_EQUAL,
+    [STATE_GREATER]       = TOK_GREATER,
+    [STATE_GREATER_EQUAL] = TOK_GREATER_EQUAL,
+    [STATE_GARBAGE]       = TOK_GARBAGE,
+};
+
+typedef struct {
+    const char* text;
+    size_t size;
+    token_kind_t kind;
+} keyword_t;
+
+// Collision free for the keyword set below; check keyword_hash() when adding one.
+#define KEYWORD_TABLE_SIZE 16
+
+static unsigned keyword_hash(const char* text, size_t size) {
+    return ((unsigned char) text[0] + ((unsigned char) text[size - 1] << 3) + size) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+static const keyword_t keywords[KEYWORD_TABLE_SIZE] = {
+    [7]  = { "def",    3, TOK_DEF },
+    [15] = { "let",    3, TOK_LET },
+    [8]  = { "return", 6, TOK_RETURN },
+    [1]  = { "or",     2, TOK_OR },
+    [4]  = { "and",    3, TOK_AND },
+    [0]  = { "true",   4, TOK_TRUE },
+    [3]  = { "false",  5, TOK_FALSE },
+};
+
+static token_kind_t lookup_keyword(const char* text, size_t size) {
+    const keyword_t* keyword = &keywords[keyword_hash(text, size)];
+    if (keyword->size == size && memcmp(keyword->text, text, size) == 0) {
+        return keyword->kind;
+    }
+
+    return TOK_IDENTIFIER;
+}
+
+// Garbage starting with a digit can only be a float literal missing its
+// fractional part; anything else was unlexable from its first byte.
+static void report_garbage(lexer_t* lexer, sv_t span) {
+    location_t location = lexer_location(lexer, span.data - lexer->input);
+
+    if (char_classes[(unsigned char) span.data[0]] == CHAR_DIGIT) {
+        fprintf(lexer->diagnostics,
+                LOCATION_FMT" WARNING: invalid floating point will result to garbage token.\n",
+                LOCATION_ARG(location));
+    } else {
+        fprintf(lexer->diagnostics, LOCATION_FMT" WARNING: garbage token: "SV_FMT"\n", LOCATION_ARG(location), SV_ARG(span));
+    }
+}
+
+token_t lexer_next_token(lexer_t* lexer) {
+    skip_ws_and_comments(lexer);
 
-        const char* start = &lexer->input[lexer->cursor];
-        const int start_line = lexer->line;
-        const int start_col  = lexer->col;
+    const char* start = lexer->cursor;
+
+    if (is_eof(lexer)) {
+        return token_make(TOK_EOF, sv_make(start, 0));
+    }
 
-        if (is_eof(lexer)) {
-            dynarray_push_rval(tokens, token_make(TOK_EOF, sv_make_from(""), location_make(start_line, start_col)));
+    const unsigned char* p   = (const unsigned char*) start;
+    const unsigned char* end = (const unsigned char*) lexer->end;
+
+    lex_state_t state = STATE_START;
+    while (p < end) {
+        lex_state_t next = transitions[state][char_classes[*p]];
+        if (next == STATE_DONE) {
             break;
         }
 
-        switch (current(lexer))  {
-            case '(':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_LPAREN, sv_make_from("("), location_make(start_line, start_col)));
-                continue;
-            case ')':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_RPAREN, sv_make_from(")"), location_make(start_line, start_col)));
-                continue;
-            case '{':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_LCURLY, sv_make_from("{"), location_make(start_line, start_col)));
-                continue;
-            case '}':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_RCURLY, sv_make_from("}"), location_make(start_line, start_col)));
-                continue;
-            case '=':
-                advance(lexer);
-                if (current(lexer) == '=') {
-                    advance(lexer);
-
-                    dynarray_push_rval(tokens, token_make(TOK_EQUAL_EQUAL, sv_make_from("=="), location_make(start_line, start_col)));
-                    continue;
-                }
-                dynarray_push_rval(tokens, token_make(TOK_EQUAL, sv_make_from("="), location_make(start_line, start_col)));
-                continue;
-            case ':':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_COLON, sv_make_from(":"), location_make(start_line, start_col)));
-                continue;
-            case ',':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_COMMA, sv_make_from(","), location_make(start_line, start_col)));
-                continue;
-            case ';':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_SEMICOLON, sv_make_from(";"), location_make(start_line, start_col)));
-                continue;
-            case '!':
-                advance(lexer);
-                if (current(lexer) == '=') {
-                    advance(lexer);
-
-                    dynarray_push_rval(tokens, token_make(TOK_BANG_EQUAL, sv_make_from("!="), location_make(start_line, start_col)));
-                    continue;
-                }
-                dynarray_push_rval(tokens, token_make(TOK_BANG, sv_make_from("!"), location_make(start_line, start_col)));
-                continue;
-            case '+':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_PLUS, sv_make_from("+"), location_make(start_line, start_col)));
-                continue;
-            case '-':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_MINUS, sv_make_from("-"), location_make(start_line, start_col)));
-                continue;
-            case '*':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_STAR, sv_make_from("*"), location_make(start_line, start_col)));
-                continue;
-            case '/':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_SLASH, sv_make_from("/"), location_make(start_line, start_col)));
-                continue;
-            case '<':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_LESS, sv_make_from("<"), location_make(start_line, start_col)));
-                continue;
-            case '>':
-                advance(lexer);
-                dynarray_push_rval(tokens, token_make(TOK_GREATER, sv_make_from(">"), location_make(start_line, start_col)));
-                continue;
-            default:
+        state = next;
+        p++;
+    }
+
+    size_t len = (const char*) p - start;
+    lexer->cursor += len;
+
+    sv_t span = sv_make(start, len);
+
+    switch (state) {
+        case STATE_IDENT: {
+            token_t token = token_make(lookup_keyword(start, len), span);
+            if (token.kind == TOK_IDENTIFIER && lexer->interner) {
+                token.symbol = interner_intern(lexer->interner, span);
+            }
+
+            return token;
+        }
+        case STATE_SINGLE:
+            return token_make(single_char_kinds[(unsigned char) *start], span);
+        case STATE_FLOAT_DOT:
+        case STATE_GARBAGE:
+            if (!lexer->quiet) {
+                report_garbage(lexer, span);
+            }
+            break;
+        default:
+            break;
+    }
+
+    return token_make(accepting_kinds[state], span);
+}
+
+void get_tokens(lexer_t* lexer, token_buffer_t* tokens) {
+    while (true) {
+        token_t token = lexer_next_token(lexer);
+        token_buffer_push(tokens, token.kind, token.span.data - lexer->input, token.span.size, token.symbol);
+
+        if (token.kind == TOK_EOF) {
+            break;
+        }
+    }
+}
+
+// Index of the first element of the sorted `values` greater than `value`.
+static size_t upper_bound(const uint64_t* values, size_t count, uint64_t value) {
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (values[mid] <= value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+// A token depends only on its own bytes and the byte that ends it, and the
+// lexer carries no state across tokens. Tokens ending before the edit are
+// therefore kept, and once a fresh token starts past the edit at the shifted
+// offset of an old token, the rest of the old stream is known to be equal.
+void lexer_relex(lexer_t* lexer, token_buffer_t* tokens, const char* input, size_t size, lexer_edit_t edit) {
+    int64_t delta = (int64_t) edit.new_end - (int64_t) edit.old_end;
+    size_t count = token_buffer_length(tokens);
+
+    size_t first = 0;
+    size_t last  = count;
+    while (first < last) {
+        size_t mid = first + (last - first) / 2;
+        if (tokens->starts[mid] + tokens->lengths[mid] < edit.start) {
+            first = mid + 1;
+        } else {
+            last = mid;
+        }
+    }
+
+    uint64_t restart = first > 0 ? tokens->starts[first - 1] + tokens->lengths[first - 1] : 0;
+
+    // Set aside the line starts past the restart point; they are shifted back
+    // in once the streams are in sync again.
+    size_t lines = dynarray_length(lexer->line_starts);
+    size_t kept_lines = upper_bound(lexer->line_starts, lines, restart);
+    size_t moved_lines = lines - kept_lines;
+
+    uint64_t* old_lines = mem_alloc(moved_lines * sizeof(uint64_t));
+    memcpy(old_lines, &lexer->line_starts[kept_lines], moved_lines * sizeof(uint64_t));
+    _dynarray_field_set(lexer->line_starts, LENGTH, kept_lines);
+
+    lexer->input  = input;
+    lexer->end    = input + size;
+    lexer->cursor = input + restart;
+
+    token_buffer_t fresh;
+    token_buffer_init(&fresh);
+
+    size_t sync = first;
+    uint64_t sync_start = size;
+    while (true) {
+        token_t token = lexer_next_token(lexer);
+        uint64_t start = token.span.data - input;
+
+        if (start >= edit.new_end) {
+            while (sync < count && (int64_t) tokens->starts[sync] + delta < (int64_t) start) {
+                sync++;
+            }
+
+            if (sync < count && (int64_t) tokens->starts[sync] + delta == (int64_t) start) {
+                sync_start = start;
                 break;
+            }
         }
 
-        if (isdigit(current(lexer))) {
-            int len = 0;
-            do {
-                len++;
-                advance(lexer);
-            } while (!is_eof(lexer) && isdigit(current(lexer)));
+        token_buffer_push(&fresh, token.kind, start, token.span.size, token.symbol);
 
-            if (current(lexer) == '.') {
-                len++;
-                advance(lexer);
+        if (token.kind == TOK_EOF) {
+            sync = count;
+            break;
+        }
+    }
 
-                int mantissa = 0;
-                while (!is_eof(lexer) && isdigit(current(lexer))) {
-                    mantissa++;
-                    advance(lexer);
-                }
+    token_buffer_splice(tokens, first, sync - first, &fresh);
 
-                if (mantissa == 0) {
-                    fprintf(stderr, 
-                            LOCATION_FMT" WARNING: invalid floating point will result to garbage token.\n",
-                            LOCATION_ARG(location_make(start_line, start_col)));
+    size_t shifted = first + token_buffer_length(&fresh);
+    if (delta != 0) {
+        size_t total = token_buffer_length(tokens);
+        for (size_t i = shifted; i < total; i++) {
+            tokens->starts[i] += delta;
+        }
+    }
 
-                    dynarray_push_rval(tokens, token_make(TOK_GARBAGE, sv_make(start, len + mantissa), location_make(start_line, start_col)));
-                    continue;
-                }
+    size_t resumed = upper_bound(old_lines, moved_lines, sync_start - delta);
+    size_t relexed_lines = dynarray_length(lexer->line_starts);
+    dynarray_splice(lexer->line_starts, relexed_lines, 0, &old_lines[resumed], moved_lines - resumed);
+
+    if (delta != 0) {
+        size_t total = dynarray_length(lexer->line_starts);
+        for (size_t i = relexed_lines; i < total; i++) {
+            lexer->line_starts[i] += delta;
+        }
+    }
+
+    mem_free(old_lines);
+    token_buffer_deinit(&fresh);
+}
+
+// Chunks per thread, so a chunk full of long comments does not hold up the
+// whole job.
+#define LEX_CHUNKS_PER_THREAD 4
+#define LEX_MIN_CHUNK_SIZE (64 * 1024)
 
-                dynarray_push_rval(tokens, token_make(TOK_FLOATLITERAL, sv_make(start, len + mantissa), location_make(start_line, start_col)));
-                continue;
+typedef struct {
+    const char* begin;
+    const char* end;
+
+    token_buffer_t tokens;
+    uint64_t* line_starts;
+} lex_chunk_t;
+
+typedef struct {
+    lex_chunk_t* chunks;
+    size_t count;
+    atomic_size_t next;
+} lex_job_t;
+
+static void* lex_worker(void* arg) {
+    lex_job_t* job = arg;
+
+    while (true) {
+        size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->count) {
+            break;
+        }
+
+        lex_chunk_t* chunk = &job->chunks[i];
+
+        lexer_t lexer;
+        lexer_init(&lexer, chunk->begin, chunk->end - chunk->begin);
+        lexer.quiet = true;
+
+        token_buffer_init(&chunk->tokens);
+        get_tokens(&lexer, &chunk->tokens);
+
+        chunk->line_starts = lexer.line_starts;
+        lexer.line_starts = dynarray_create(uint64_t);
+        lexer_deinit(&lexer);
+    }
+
+    return NULL;
+}
+
+// Chunks are split right after a newline. Comments end at the newline and no
+// token spans one, so every chunk starts outside any comment or token and
+// can be lexed independently of the ones before it.
+void get_tokens_parallel(lexer_t* lexer, token_buffer_t* tokens, int threads) {
+    size_t size = lexer->end - lexer->cursor;
+    size_t target = size / ((size_t) threads * LEX_CHUNKS_PER_THREAD);
+    if (target < LEX_MIN_CHUNK_SIZE) {
+        target = LEX_MIN_CHUNK_SIZE;
+    }
+
+    lex_chunk_t* chunks = dynarray_create(lex_chunk_t);
+    for (const char* begin = lexer->cursor; begin < lexer->end || dynarray_length(chunks) == 0;) {
+        const char* end = lexer->end;
+        if ((size_t) (lexer->end - begin) > target) {
+            const char* newline = memchr(begin + target, '\n', lexer->end - begin - target);
+            if (newline) {
+                end = newline + 1;
             }
+        }
+
+        dynarray_push_rval(chunks, ((lex_chunk_t) { .begin = begin, .end = end }));
+        begin = end;
+    }
+
+    lex_job_t job = {
+        .chunks = chunks,
+        .count = dynarray_length(chunks),
+    };
+    atomic_init(&job.next, 0);
 
-            dynarray_push_rval(tokens, token_make(TOK_INTLITERAL, sv_make(start, len), location_make(start_line, start_col)));
-            continue;
-        }
-
-        if (isalpha(current(lexer)) || current(lexer) == '_') {
-            int len = 0;
-            do {
-                len++;
-                advance(lexer);
-            } while (!is_eof(lexer) && (isalnum(current(lexer)) || current(lexer) == '_'));
-
-            sv_t span = sv_make(start, len);
-
-            if (sv_equals(span, sv_make_from("def"))) {
-                dynarray_push_rval(tokens, token_make(TOK_DEF, sv_make_from("def"), location_make(start_line, start_col)));
-                continue;
-            } else if (sv_equals(span, sv_make_from("let"))) {
-                dynarray_push_rval(tokens, token_make(TOK_LET, sv_make_from("let"), location_make(start_line, start_col)));
-                continue;
-            } else if (sv_equals(span, sv_make_from("return"))) {
-                dynarray_push_rval(tokens, token_make(TOK_RETURN, sv_make_from("return"), location_make(start_line, start_col)));
-                continue;
-            } else if (sv_equals(span, sv_make_from("or"))) {
-                dynarray_push_rval(tokens, token_make(TOK_OR, sv_make_from("or"), location_make(start_line, start_col)));
-                continue;
-            } else if (sv_equals(span, sv_make_from("and"))) {
-                dynarray_push_rval(tokens, token_make(TOK_AND, sv_make_from("and"), location_make(start_line, start_col)));
-                continue;
-            } else if (sv_equals(span, sv_make_from("true"))) {
-                dynarray_push_rval(tokens, token_make(TOK_TRUE, sv_make_from("true"), location_make(start_line, start_col)));
-                continue;
-            } else if (sv_equals(span, sv_make_from("false"))) {
-                dynarray_push_rval(tokens, token_make(TOK_FALSE, sv_make_from("false"), location_make(start_line, start_col)));
-                continue;
-            }else {
-                dynarray_push_rval(tokens, token_make(TOK_IDENTIFIER, sv_make(start, len), location_make(start_line, start_col)));
-                continue;
+    if (threads > (int) job.count) {
+        threads = job.count;
+    }
+
+    // If a thread cannot be started, the ones that were share the chunks.
+    pthread_t* workers = mem_alloc(sizeof(pthread_t) * threads);
+    int started = 1;
+    while (started < threads && pthread_create(&workers[started], NULL, lex_worker, &job) == 0) {
+        started++;
+    }
+
+    lex_worker(&job);
+
+    for (int i = 1; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    mem_free(workers);
+
+    for (size_t i = 0; i < job.count; i++) {
+        lex_chunk_t* chunk = &chunks[i];
+        uint64_t base = chunk->begin - lexer->input;
+
+        // Every chunk but the last ends in a newline, so its EOF is dropped.
+        size_t count = token_buffer_length(&chunk->tokens);
+        if (i + 1 < job.count) {
+            count--;
+        }
+
+        size_t first_token = token_buffer_length(tokens);
+        dynarray_splice(tokens->kinds, first_token, 0, chunk->tokens.kinds, count);
+        dynarray_splice(tokens->starts, first_token, 0, chunk->tokens.starts, count);
+        dynarray_splice(tokens->lengths, first_token, 0, chunk->tokens.lengths, count);
+        dynarray_splice(tokens->symbols, first_token, 0, chunk->tokens.symbols, count);
+
+        for (size_t j = first_token; j < first_token + count; j++) {
+            tokens->starts[j] += base;
+        }
+
+        // Workers lex without an interner so they share nothing. Interning
+        // here, in source order, hands out the same ids a serial lex would.
+        if (lexer->interner) {
+            for (size_t j = first_token; j < first_token + count; j++) {
+                if (tokens->kinds[j] == TOK_IDENTIFIER) {
+                    sv_t name = sv_make(lexer->input + tokens->starts[j], tokens->lengths[j]);
+                    tokens->symbols[j] = interner_intern(lexer->interner, name);
+                }
             }
         }
 
-        int len = 0;
-        do {
-            len++;
-            advance(lexer);
-        } while (!is_eof(lexer) && !isspace(current(lexer)));
+        // The chunk's first line start is already known from the chunk before.
+        size_t first_line = dynarray_length(lexer->line_starts);
+        size_t lines = dynarray_length(chunk->line_starts) - 1;
+        dynarray_splice(lexer->line_starts, first_line, 0, &chunk->line_starts[1], lines);
 
-        sv_t span = sv_make(start, len);
+        for (size_t j = first_line; j < first_line + lines; j++) {
+            lexer->line_starts[j] += base;
+        }
 
-        fprintf(stderr, LOCATION_FMT" WARNING: garbage token: "SV_FMT"\n", LOCATION_ARG(location_make(start_line, start_col)), SV_ARG(span));
-        dynarray_push_rval(tokens, token_make(TOK_GARBAGE, span, location_make(start_line, start_col)));
-        continue;
+        token_buffer_deinit(&chunk->tokens);
+        dynarray_destroy(chunk->line_starts);
     }
 
-    return tokens;
+    dynarray_destroy(chunks);
+    lexer->cursor = lexer->end;
+
+    if (!lexer->quiet) {
+        size_t count = token_buffer_length(tokens);
+        for (size_t i = 0; i < count; i++) {
+            if (tokens->kinds[i] == TOK_GARBAGE) {
+                report_garbage(lexer, sv_make(lexer->input + tokens->starts[i], tokens->lengths[i]));
+            }
+        }
+    }
 }
@@ -1,15 +1,50 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <interner.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <token.h>
 
+// The input is not required to be NUL-terminated; `end` bounds every read.
 typedef struct {
-    char* input;
-    int cursor;
-    int line;
-    int col;
+    const char* input;
+    const char* end;
+    const char* cursor;
+
+    // Offset of the first byte of every line seen so far, used to resolve
+    // token offsets into line and column only when a location is needed.
+    uint64_t* line_starts;
+
+    // Suppresses warnings; used by workers that cannot resolve locations yet.
+    bool quiet;
+
+    // Skips whitespace and comments a byte at a time even where SIMD is
+    // available, so tests can compare the two.
+    bool scalar;
+
+    // Identifiers are interned here as they are lexed, unless it is NULL.
+    interner_t* interner;
+
+    // Where warnings, and the parser's errors, are reported.
+    FILE* diagnostics;
 } lexer_t;
 
-void lexer_init(lexer_t*, char*);
+void lexer_init(lexer_t*, const char*, size_t);
 void lexer_deinit(lexer_t*);
 
-token_t* get_tokens(lexer_t*);
+location_t lexer_location(lexer_t*, uint64_t);
+
+// Bytes [start, old_end) of the previous input were replaced by bytes
+// [start, new_end) of the new one.
+typedef struct {
+    uint64_t start;
+    uint64_t old_end;
+    uint64_t new_end;
+} lexer_edit_t;
+
+token_t lexer_next_token(lexer_t*);
+void get_tokens(lexer_t*, token_buffer_t*);
+void get_tokens_parallel(lexer_t*, token_buffer_t*, int);
+void lexer_relex(lexer_t*, token_buffer_t*, const char*, size_t, lexer_edit_t);
@@ -1,72 +1,191 @@
-#include <compiler.h>
-#include <codegen.h>
+#include <alloc.h>
+#include <cache.h>
 #include <dynarray/dynarray.h>
 #include <errno.h>
-#include <lexer.h>
-#include <parser.h>
+#include <fcntl.h>
+#include <jit.h>
+#include <protocol.h>
+#include <server.h>
+#include <session.h>
+#include <source.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <timing.h>
+#include <unistd.h>
 
-static char* slurp_file(const char* filepath) {
-    FILE* stream = fopen(filepath, "r");
-    if (!stream) {
-        fprintf(stderr, "ERROR: cannot open file '%s': %s", filepath, strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-
-    fseek(stream, 0, SEEK_END);
-    long size = ftell(stream);
-    fseek(stream, 0, SEEK_SET);
+static void usage(const char* program) {
+    fprintf(stderr, "usage: %s [-j threads] [--cache dir] [--time-passes[=json]] [--stats] [--emit=asm|obj|exe] [-o output] <file>\n", program);
+    fprintf(stderr, "       %s [-j threads] [--cache dir] [--time-passes[=json]] [--stats] --run <file>\n", program);
+    fprintf(stderr, "       %s [-j threads] [--cache dir] [--time-passes[=json]] [--stats] [--emit=asm|obj|exe] [--socket path] --server\n", program);
+}
 
-    if (size == 0) {
-        fclose(stream);
-        return NULL;
+// The output goes out in as few writes as the kernel allows, and the file
+// is only created once the program has compiled.
+static bool write_output(emitter_t* output, const char* path, output_format_t format) {
+    int fd = STDOUT_FILENO;
+    if (path) {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, format == OUTPUT_EXECUTABLE ? 0755 : 0644);
+        if (fd < 0) {
+            fprintf(stderr, "ERROR: cannot open '%s': %s\n", path, strerror(errno));
+            return false;
+        }
     }
 
-    char* buffer = malloc(sizeof(char) * size + 1);
-    fread(buffer, sizeof(char), size, stream);
-    buffer[size] = 0;
+    bool written = emitter_write(output, fd);
+    if (!written) {
+        fprintf(stderr, "ERROR: cannot write '%s': %s\n", path ? path : "<stdout>", strerror(errno));
+    }
 
-    fclose(stream);
+    if (path && close(fd) != 0 && written) {
+        fprintf(stderr, "ERROR: cannot write '%s': %s\n", path, strerror(errno));
+        written = false;
+    }
 
-    return buffer;
+    return written;
 }
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
+    const char* filepath = NULL;
+    const char* output_path = NULL;
+    int threads = 1;
+    const char* cache_dir = NULL;
+    const char* socket_path = NULL;
+    bool server = false;
+    bool time_passes = false;
+    bool time_passes_json = false;
+    bool stats = false;
+    bool run = false;
+    output_format_t format = OUTPUT_ASSEMBLY;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--time-passes") == 0) {
+            time_passes = true;
+        } else if (strcmp(argv[i], "--time-passes=json") == 0) {
+            time_passes = true;
+            time_passes_json = true;
+        } else if (strcmp(argv[i], "--emit=asm") == 0) {
+            format = OUTPUT_ASSEMBLY;
+        } else if (strcmp(argv[i], "--emit=obj") == 0) {
+            format = OUTPUT_OBJECT;
+        } else if (strcmp(argv[i], "--emit=exe") == 0) {
+            format = OUTPUT_EXECUTABLE;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            run = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if (strcmp(argv[i], "--server") == 0) {
+            server = true;
+        } else if (!filepath) {
+            filepath = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (server == (filepath != NULL) || (server && output_path)) {
+        usage(argv[0]);
         return 1;
     }
 
-    char* buffer = slurp_file(argv[1]);
+    if (run) {
+        if (server || output_path || format != OUTPUT_ASSEMBLY) {
+            usage(argv[0]);
+            return 1;
+        }
 
-    lexer_t lexer;
-    lexer_init(&lexer, buffer);
+        format = OUTPUT_MACHINE_CODE;
+    }
 
-    token_t* tokens = get_tokens(&lexer);
-    parser_t parser;
-    parser_init(&parser, tokens);
+    mem_init(stats);
 
-    compiler_t compiler;
-    compiler_init(&compiler);
+    pass_report_t report;
+    pass_report_init(&report);
 
-    push_scope(&compiler);
+    pass_clock_t start = pass_begin(false);
 
-    function_definition_t* add = parse_function_definition(&parser);
-    compile_function_definition(&compiler, add);
-    function_definition_free(add);
+    source_t source = { 0 };
+    if (filepath && !source_open(&source, filepath)) {
+        exit(EXIT_FAILURE);
+    }
 
-    pop_scope(&compiler);
+    pass_end(&report, PASS_READ, start);
 
-    push_scope(&compiler);
+    compile_cache_t cache;
+    if (cache_dir) {
+        compile_cache_open(&cache, cache_dir);
+    }
 
-    function_definition_t* main = parse_function_definition(&parser);
-    compile_function_definition(&compiler, main);
-    function_definition_free(main);
+    session_t session;
+    session_init(&session, threads, cache_dir ? &cache : NULL, time_passes ? &report : NULL, format);
+
+    bool succeeded;
+    int status = EXIT_SUCCESS;
+
+    if (server) {
+        succeeded = run_server(&session, protocol_socket_path(socket_path));
+    } else {
+        emitter_t output;
+        emitter_init(&output);
+
+        succeeded = session_compile(&session, source.data, source.size, &output, stderr);
+        source_close(&source);
+
+        if (succeeded && run) {
+            // Like an executable, the program's result is the exit status,
+            // and a main that returns nothing exits with 0.
+            program_t* program = &session.program;
+            jit_t jit;
+            start = pass_begin(false);
+            succeeded = jit_load(&jit, output.data, output.size, program->main.offset, program->symbols, dynarray_length(program->symbols));
+            pass_end(&report, PASS_OUTPUT, start);
+
+            if (succeeded) {
+                int64_t result = jit_run(&jit);
+                status = program->main.returns_value ? result & 0xff : EXIT_SUCCESS;
+                jit_unload(&jit);
+            }
+        } else if (succeeded) {
+            start = pass_begin(false);
+            succeeded = write_output(&output, output_path, format);
+            pass_end(&report, PASS_OUTPUT, start);
+        }
+
+        emitter_deinit(&output);
+    }
 
-    pop_scope(&compiler);
+    session_deinit(&session);
+
+    if (cache_dir) {
+        compile_cache_close(&cache);
+    }
+
+    // The server's report covers every request it served.
+    if (time_passes_json) {
+        pass_report_print_json(&report, stderr);
+    } else if (time_passes) {
+        pass_report_print(&report, stderr);
+    }
+
+    // Printed once everything is freed, so live bytes are what leaked.
+    if (stats) {
+        mem_stats_t usage;
+        mem_get_stats(&usage);
+        mem_stats_print(&usage, stderr);
+    }
 
-    compiler_deinit(&compiler);
-    parser_deinit(&parser);
-    lexer_deinit(&lexer);
+    return succeeded ? status : EXIT_FAILURE;
 }
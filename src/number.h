@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sv/sv.h>
+
+// Literal parsers that read exactly the span they are given, so they never
+// rely on a terminator and do not depend on the locale.
+
+// Fails if the span is not all digits or the value does not fit an int64_t.
+bool parse_int_literal(sv_t, int64_t*);
+
+// Parses `digits.digits`, correctly rounded to the nearest double.
+double parse_float_literal(sv_t);
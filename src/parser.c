@@ -1,22 +1,84 @@
+#include <alloc.h>
 #include <dynarray/dynarray.h>
+#include <number.h>
 #include <parser.h>
+#include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+// Stops after EOF, which then stays the last token of every batch.
+static void lex_batch(parser_t* parser) {
+    mem_tag_t tag = mem_set_tag(MEM_LEXER);
+    pass_clock_t start = parser->timed ? pass_begin(true) : (pass_clock_t) { 0 };
+
+    uint32_t count = 0;
+    do {
+        parser->batch[count++] = lexer_next_token(parser->lexer);
+    } while (count < PARSER_BATCH && parser->batch[count - 1].kind != TOK_EOF);
+
+    if (parser->timed) {
+        pass_time_t time = pass_elapsed(start);
+        parser->lex_time.wall += time.wall;
+        parser->lex_time.cpu += time.cpu;
+    }
+
+    mem_set_tag(tag);
 
-static token_t current(parser_t* parser) {
-    return parser->tokens[parser->cursor];
+    parser->lexed += count;
+    parser->batch_next = 0;
+    parser->batch_count = count;
 }
 
-static bool is_eof(parser_t* parser) {
-    return current(parser).kind == TOK_EOF;
+static token_t next_token(parser_t* parser) {
+    if (!parser->tokens) {
+        if (parser->batch_next == parser->batch_count) {
+            lex_batch(parser);
+        }
+
+        token_t* token = &parser->batch[parser->batch_next];
+        if (token->kind != TOK_EOF) {
+            parser->batch_next++;
+        }
+
+        return *token;
+    }
+
+    token_buffer_t* tokens = parser->tokens;
+    size_t i = parser->next_token;
+
+    // Stay on the final EOF once it is reached.
+    if (i + 1 < token_buffer_length(tokens)) {
+        parser->next_token++;
+    }
+
+    token_t token = token_make(tokens->kinds[i], sv_make(parser->lexer->input + tokens->starts[i], tokens->lengths[i]));
+    token.symbol = tokens->symbols[i];
+
+    return token;
 }
 
-static bool expect(parser_t* parser, token_kind_t kind) {
-    if (is_eof(parser)) {
-        return false;
+// The returned token is overwritten once the parser advances past it, so
+// read what is needed from it before advancing.
+static token_t* current(parser_t* parser) {
+    if (!parser->buffered) {
+        parser->lookahead = next_token(parser);
+        parser->buffered = true;
     }
 
-    return current(parser).kind == kind;
+    return &parser->lookahead;
+}
+
+static location_t current_location(parser_t* parser) {
+    return lexer_location(parser->lexer, current(parser)->span.data - parser->lexer->input);
+}
+
+static bool is_eof(parser_t* parser) {
+    return current(parser)->kind == TOK_EOF;
+}
+
+static bool expect(parser_t* parser, token_kind_t kind) {
+    return kind != TOK_EOF && current(parser)->kind == kind;
 }
 
 static void advance(parser_t* parser) {
@@ -24,46 +86,96 @@ static void advance(parser_t* parser) {
         return;
     }
 
-    parser->cursor++;
+    parser->buffered = false;
+}
+
+// The error has been reported. Parsing a translation unit unwinds to
+// parse_translation_unit; anything else gives up on the process.
+static _Noreturn void fail(parser_t* parser) {
+    if (parser->failure) {
+        longjmp(*parser->failure, 1);
+    }
+
+    exit(EXIT_FAILURE);
 }
 
 static void match(parser_t* parser, token_kind_t kind) {
     if (!expect(parser, kind)) {
-        fprintf(stderr, LOCATION_FMT" ERROR: expected: %s but got "SV_FMT"\n", LOCATION_ARG(current(parser).location), token_kind_to_str(kind), SV_ARG(current(parser).span));
-        exit(EXIT_FAILURE);
+        fprintf(parser->lexer->diagnostics, LOCATION_FMT" ERROR: expected: %s but got "SV_FMT"\n", LOCATION_ARG(current_location(parser)), token_kind_to_str(kind), SV_ARG(current(parser)->span));
+        fail(parser);
     }
 
     advance(parser);
 }
 
-void parser_init(parser_t* parser, token_t* tokens) {
+static node_t node_from(parser_t* parser, node_kind_t kind, const token_t* token) {
+    node_t node = node_make(kind, token->span.data - parser->lexer->input);
+    node.symbol = token->symbol;
+
+    return node;
+}
+
+// Moves the ids pushed on the scratch stack since `mark` into the AST's list
+// array and pops them. Child lists nest, so one stack serves every list
+// being built.
+static node_range_t take_scratch(parser_t* parser, size_t mark) {
+    size_t count = dynarray_length(parser->scratch) - mark;
+    node_range_t range = ast_push_list(parser->ast, &parser->scratch[mark], count);
+    _dynarray_field_set(parser->scratch, LENGTH, mark);
+
+    return range;
+}
+
+void parser_init(parser_t* parser, lexer_t* lexer, ast_t* ast) {
+    parser->ast         = ast;
+    parser->scratch     = dynarray_create(node_id_t);
+    parser->lexer       = lexer;
+    parser->tokens      = NULL;
+    parser->next_token  = 0;
+    parser->batch_next  = 0;
+    parser->batch_count = 0;
+    parser->lexed       = 0;
+    parser->timed       = false;
+    parser->lex_time    = (pass_time_t) { 0 };
+    parser->buffered    = false;
+    parser->failure     = NULL;
+}
+
+void parser_init_tokens(parser_t* parser, lexer_t* lexer, token_buffer_t* tokens, ast_t* ast) {
+    parser_init(parser, lexer, ast);
     parser->tokens = tokens;
-    parser->cursor = 0;
 }
 
 void parser_deinit(parser_t* parser) {
-    dynarray_destroy(parser->tokens);
+    dynarray_destroy(parser->scratch);
+    parser->lexer = NULL;
+    parser->buffered = false;
 }
 
-expression_t* parse_primary(parser_t* parser) {
-    location_t location = current(parser).location;
+node_id_t parse_primary(parser_t* parser) {
+    token_t* token = current(parser);
 
-    if (expect(parser, TOK_LPAREN)) {
-        advance(parser);
+    switch (token->kind) {
+        case TOK_LPAREN: {
+            advance(parser);
 
-        expression_t* expr = parse_expression(parser);
+            node_id_t expr = parse_expression(parser);
 
-        match(parser, TOK_RPAREN);
+            match(parser, TOK_RPAREN);
 
-        return expr;
-    } else if (expect(parser, TOK_IDENTIFIER)) {
-        token_t id = current(parser);
-        advance(parser);
+            return expr;
+        }
+        case TOK_IDENTIFIER: {
+            node_t identifier = node_from(parser, NODE_IDENTIFIER, token);
+            advance(parser);
+
+            if (!expect(parser, TOK_LPAREN)) {
+                return ast_push(parser->ast, identifier);
+            }
 
-        if (expect(parser, TOK_LPAREN)) {
             advance(parser);
 
-            funcall_t* funcall = funcall_make(id.span, location);
+            size_t mark = dynarray_length(parser->scratch);
 
             bool first = true;
             while (!is_eof(parser) && !expect(parser, TOK_RPAREN)) {
@@ -71,264 +183,199 @@ expression_t* parse_primary(parser_t* parser) {
                     match(parser, TOK_COMMA);
                 }
 
-                dynarray_push_rval(funcall->arguments, parse_expression(parser));
+                dynarray_push_rval(parser->scratch, parse_expression(parser));
                 first = false;
             }
 
             match(parser, TOK_RPAREN);
 
-            expression_t* expr = expression_make(EXPR_PRIMARY, location);
-            primary_t* primary = primary_make(PRIMARY_FUNCALL, location);
-            primary->as.funcall = funcall;
-            expr->as.primary = primary;
+            node_t funcall = identifier;
+            funcall.kind = NODE_FUNCALL;
+            funcall.as.range = take_scratch(parser, mark);
 
-            return expr;
+            return ast_push(parser->ast, funcall);
         }
+        case TOK_INTLITERAL: {
+            node_t integer = node_from(parser, NODE_INTEGER, token);
+            if (!parse_int_literal(token->span, &integer.as.integer)) {
+                fprintf(parser->lexer->diagnostics, LOCATION_FMT" ERROR: integer literal "SV_FMT" is out of range\n", LOCATION_ARG(current_location(parser)), SV_ARG(token->span));
+                fail(parser);
+            }
+            advance(parser);
 
-        expression_t* expr = expression_make(EXPR_PRIMARY, location);
-        primary_t* primary = primary_make(PRIMARY_IDENTIFIER, location);
-        primary->as.identifier = id.span;
-        expr->as.primary = primary;
-
-        return expr;
-    } else if (expect(parser, TOK_INTLITERAL)) {
-        token_t int_literal = current(parser);
-        advance(parser);
-
-        expression_t* expr = expression_make(EXPR_PRIMARY, location);
-        primary_t* primary = primary_make(PRIMARY_INTEGER, location);
-        primary->as.integer = strtoll(int_literal.span.data, NULL, 10);
-        expr->as.primary = primary;
-
-        return expr;
-    } else if (expect(parser, TOK_FLOATLITERAL)) {
-        token_t float_literal = current(parser);
-        advance(parser);
-
-        expression_t* expr = expression_make(EXPR_PRIMARY, location);
-        primary_t* primary = primary_make(PRIMARY_FLOATING, location);
-        primary->as.floating = strtod(float_literal.span.data, NULL);
-        expr->as.primary = primary;
-
-        return expr;
-    } else if (expect(parser, TOK_TRUE)) {
-        token_t float_literal = current(parser);
-        advance(parser);
-
-        expression_t* expr = expression_make(EXPR_PRIMARY, location);
-        primary_t* primary = primary_make(PRIMARY_BOOLEAN, location);
-        primary->as.boolean = true;
-        expr->as.primary = primary;
-
-        return expr;
-    } else if (expect(parser, TOK_FALSE)) {
-        token_t float_literal = current(parser);
-        advance(parser);
-
-        expression_t* expr = expression_make(EXPR_PRIMARY, location);
-        primary_t* primary = primary_make(PRIMARY_BOOLEAN, location);
-        primary->as.boolean = false;
-        expr->as.primary = primary;
-
-        return expr;
-    } else {
-        fprintf(stderr, LOCATION_FMT" ERROR: expected expression\n", LOCATION_ARG(location));
-        exit(EXIT_FAILURE);
-    }
-}
-
-expression_t* parse_factor(parser_t* parser) {
-    location_t location = current(parser).location;
-    expression_t* lhs = parse_primary(parser);
-
-    while (expect(parser, TOK_STAR) || expect(parser, TOK_SLASH)) {
-        binary_op_t op = expect(parser, TOK_STAR) ? BINARY_MUL : BINARY_DIV;
-        advance(parser);
-
-        expression_t* rhs = parse_primary(parser);
-
-        expression_t* expr = expression_make(EXPR_BINARY, location);
-        binary_t* binary = binary_make(op, location, lhs, rhs);
-        expr->as.binary = binary;
-
-        lhs = expr;
-    }
-
-    return lhs;
-}
-
-expression_t* parse_term(parser_t* parser) {
-    location_t location = current(parser).location;
-    expression_t* lhs = parse_factor(parser);
-
-    while (expect(parser, TOK_PLUS) || expect(parser, TOK_MINUS)) {
-        binary_op_t op = expect(parser, TOK_PLUS) ? BINARY_ADD : BINARY_SUB;
-        advance(parser);
-
-        expression_t* rhs = parse_factor(parser);
-
-        expression_t* expr = expression_make(EXPR_BINARY, location);
-        binary_t* binary = binary_make(op, location, lhs, rhs);
-        expr->as.binary = binary;
-
-        lhs = expr;
-    }
-
-    return lhs;
-}
-
-static expression_t* parse_lower_boolean(parser_t* parser) {
-    location_t location = current(parser).location;
-    expression_t* lhs = parse_term(parser);
-
-    while (expect(parser, TOK_LESS) || expect(parser, TOK_GREATER) || expect(parser, TOK_EQUAL_EQUAL) || expect(parser, TOK_BANG_EQUAL)) {
-        binary_op_t op;
-        if (expect(parser, TOK_LESS)) {
-            op = BINARY_LESS;
-        } else if (expect(parser, TOK_GREATER)) {
-            op = BINARY_GREATER;
-        } else if (expect(parser, TOK_EQUAL_EQUAL)) {
-            op = BINARY_EQUAL;
-        } else {
-            op = BINARY_NOT_EQUAL;
+            return ast_push(parser->ast, integer);
         }
+        case TOK_FLOATLITERAL: {
+            node_t floating = node_from(parser, NODE_FLOATING, token);
+            floating.as.floating = parse_float_literal(token->span);
+            advance(parser);
 
-        advance(parser);
-
-        expression_t* rhs = parse_term(parser);
-
-        expression_t* expr = expression_make(EXPR_BINARY, location);
-        binary_t* binary = binary_make(op, location, lhs, rhs);
-        expr->as.binary = binary;
+            return ast_push(parser->ast, floating);
+        }
+        case TOK_TRUE:
+        case TOK_FALSE: {
+            node_t boolean = node_from(parser, NODE_BOOLEAN, token);
+            boolean.as.boolean = token->kind == TOK_TRUE;
+            advance(parser);
 
-        lhs = expr;
+            return ast_push(parser->ast, boolean);
+        }
+        default:
+            fprintf(parser->lexer->diagnostics, LOCATION_FMT" ERROR: expected expression\n", LOCATION_ARG(current_location(parser)));
+            fail(parser);
     }
-
-    return lhs;
 }
 
-static expression_t* parse_higher_boolean(parser_t* parser) {
-    location_t location = current(parser).location;
-    expression_t* lhs = parse_lower_boolean(parser);
+typedef struct {
+    uint8_t power;
+    uint8_t op;
+} infix_t;
+
+// Binding power of every binary operator, indexed by token kind. Tokens that
+// are not operators have no power, which ends the expression.
+static const infix_t infix_operators[TOK_COUNT] = {
+    [TOK_OR]            = { 1, BINARY_OR },
+    [TOK_AND]           = { 1, BINARY_AND },
+    [TOK_EQUAL_EQUAL]   = { 2, BINARY_EQUAL },
+    [TOK_BANG_EQUAL]    = { 2, BINARY_NOT_EQUAL },
+    [TOK_LESS]          = { 2, BINARY_LESS },
+    [TOK_GREATER]       = { 2, BINARY_GREATER },
+    [TOK_LESS_EQUAL]    = { 2, BINARY_LESS_EQUAL },
+    [TOK_GREATER_EQUAL] = { 2, BINARY_GREATER_EQUAL },
+    [TOK_PLUS]          = { 3, BINARY_ADD },
+    [TOK_MINUS]         = { 3, BINARY_SUB },
+    [TOK_STAR]          = { 4, BINARY_MUL },
+    [TOK_SLASH]         = { 4, BINARY_DIV },
+};
+
+// Operators bind to the left: the right operand only takes operators that
+// bind tighter than the one before it.
+static node_id_t parse_binary(parser_t* parser, int min_power) {
+    node_t binary = node_from(parser, NODE_BINARY, current(parser));
+    node_id_t lhs = parse_primary(parser);
+
+    while (true) {
+        infix_t infix = infix_operators[current(parser)->kind];
+        if (infix.power <= min_power) {
+            break;
+        }
 
-    while (expect(parser, TOK_OR) || expect(parser, TOK_AND)) {
-        binary_op_t op = expect(parser, TOK_OR) ? BINARY_OR : BINARY_AND;
         advance(parser);
 
-        expression_t* rhs = parse_lower_boolean(parser);
-
-        expression_t* expr = expression_make(EXPR_BINARY, location);
-        binary_t* binary = binary_make(op, location, lhs, rhs);
-        expr->as.binary = binary;
+        binary.op = infix.op;
+        binary.as.pair.lhs = lhs;
+        binary.as.pair.rhs = parse_binary(parser, infix.power);
 
-        lhs = expr;
+        lhs = ast_push(parser->ast, binary);
     }
 
     return lhs;
 }
 
-expression_t* parse_expression(parser_t* parser) {
-    return parse_higher_boolean(parser);
+node_id_t parse_expression(parser_t* parser) {
+    return parse_binary(parser, 0);
 }
 
-block_t* parse_block(parser_t* parser) {
-    block_t* block = block_make();
+node_id_t parse_block(parser_t* parser) {
+    node_t block = node_from(parser, NODE_BLOCK, current(parser));
+    size_t mark = dynarray_length(parser->scratch);
 
     match(parser, TOK_LCURLY);
 
     while (!is_eof(parser) && !expect(parser, TOK_RCURLY)) {
-        dynarray_push_rval(block->statements, parse_statement(parser));
+        dynarray_push_rval(parser->scratch, parse_statement(parser));
     }
 
     match(parser, TOK_RCURLY);
 
-    return block;
+    block.as.range = take_scratch(parser, mark);
+
+    return ast_push(parser->ast, block);
 }
 
-let_assignment_t* parse_let_assignment(parser_t* parser) {
-    location_t location = current(parser).location;
+node_id_t parse_let_assignment(parser_t* parser) {
+    node_t let_assignment = node_from(parser, NODE_LET_ASSIGNMENT, current(parser));
 
     match(parser, TOK_LET);
 
-    token_t id = current(parser);
+    node_t name = node_from(parser, NODE_NAME, current(parser));
     match(parser, TOK_IDENTIFIER);
+    let_assignment.as.pair.lhs = ast_push(parser->ast, name);
 
     match(parser, TOK_EQUAL);
 
-    expression_t* expr = parse_expression(parser);
+    node_id_t expr = parse_expression(parser);
 
     match(parser, TOK_SEMICOLON);
 
-    return let_assignment_make(id.span, location, expr);
+    let_assignment.as.pair.rhs = expr;
+
+    return ast_push(parser->ast, let_assignment);
 }
 
-return_t* parse_return(parser_t* parser) {
-    location_t location = current(parser).location;
+node_id_t parse_return(parser_t* parser) {
+    node_t ret = node_from(parser, NODE_RETURN, current(parser));
     match(parser, TOK_RETURN);
 
-    if (!expect(parser, TOK_SEMICOLON)) {
-        expression_t* expr = parse_expression(parser);
+    ret.as.pair.lhs = NODE_NONE;
+    ret.as.pair.rhs = NODE_NONE;
 
-        match(parser, TOK_SEMICOLON);
-        return return_make(expr, location);
+    if (!expect(parser, TOK_SEMICOLON)) {
+        ret.as.pair.lhs = parse_expression(parser);
     }
 
     match(parser, TOK_SEMICOLON);
-    return return_make(NULL, location);
+    return ast_push(parser->ast, ret);
 }
 
-statement_t* parse_statement(parser_t* parser) {
-    location_t location = current(parser).location;
-
+node_id_t parse_statement(parser_t* parser) {
     if (expect(parser, TOK_LCURLY)) {
-        statement_t* statement = statement_make(STMT_BLOCK, location);
-        statement->as.block = parse_block(parser);
-
-        return statement;
+        return parse_block(parser);
     } else if (expect(parser, TOK_LET)) {
-        statement_t* statement = statement_make(STMT_LET_ASSIGNMENT, location);
-        statement->as.let_assignment = parse_let_assignment(parser);
-
-        return statement;
+        return parse_let_assignment(parser);
     } else if (expect(parser, TOK_RETURN)) {
-        statement_t* statement = statement_make(STMT_RETURN, location);
-        statement->as.ret = parse_return(parser);
-
-        return statement;
+        return parse_return(parser);
     } else {
-        fprintf(stderr, LOCATION_FMT" ERROR: expected statement\n", LOCATION_ARG(current(parser).location));
-        exit(EXIT_FAILURE);
+        fprintf(parser->lexer->diagnostics, LOCATION_FMT" ERROR: expected statement\n", LOCATION_ARG(current_location(parser)));
+        fail(parser);
     }
 }
 
-parameter_t parse_parameter(parser_t* parser) {
-    location_t location = current(parser).location;
-
-    token_t name = current(parser);
+node_id_t parse_parameter(parser_t* parser) {
+    node_t parameter = node_from(parser, NODE_PARAMETER, current(parser));
     match(parser, TOK_IDENTIFIER);
 
     match(parser, TOK_COLON);
 
-    token_t type = current(parser);
     if (!expect(parser, TOK_IDENTIFIER)) {
-        fprintf(stderr, LOCATION_FMT" ERROR: expected type\n", LOCATION_ARG(current(parser).location));
-        exit(EXIT_FAILURE);
+        fprintf(parser->lexer->diagnostics, LOCATION_FMT" ERROR: expected type\n", LOCATION_ARG(current_location(parser)));
+        fail(parser);
     }
+
+    parameter.as.pair.lhs = ast_push(parser->ast, node_from(parser, NODE_NAME, current(parser)));
     advance(parser);
 
-    return parameter_make(name.span, type.span, location);
+    parameter.as.pair.rhs = NODE_NONE;
+
+    return ast_push(parser->ast, parameter);
 }
 
-function_signature_t* parse_function_signature(parser_t* parser) {
-    location_t location = current(parser).location;
+node_id_t parse_function_definition(parser_t* parser) {
+    node_t fundef = node_from(parser, NODE_FUNCTION_DEFINITION, current(parser));
     match(parser, TOK_DEF);
 
-    token_t name = current(parser);
+    node_t name = node_from(parser, NODE_NAME, current(parser));
     match(parser, TOK_IDENTIFIER);
 
-    match(parser, TOK_LPAREN);
+    // The slots before FUNCTION_PARAMETERS are filled in once they are parsed.
+    size_t mark = dynarray_length(parser->scratch);
+    for (int i = 0; i < FUNCTION_PARAMETERS; i++) {
+        dynarray_push_rval(parser->scratch, (node_id_t) NODE_NONE);
+    }
 
-    function_signature_t* funsig = function_signature_make(name.span, location);
+    parser->scratch[mark + FUNCTION_NAME] = ast_push(parser->ast, name);
+
+    match(parser, TOK_LPAREN);
 
     bool first = true;
     while (!is_eof(parser) && !expect(parser, TOK_RPAREN)) {
@@ -336,7 +383,7 @@ function_signature_t* parse_function_signature(parser_t* parser) {
             match(parser, TOK_COMMA);
         }
 
-        dynarray_push_rval(funsig->parameters, parse_parameter(parser));
+        dynarray_push_rval(parser->scratch, parse_parameter(parser));
         first = false;
     }
 
@@ -344,22 +391,41 @@ function_signature_t* parse_function_signature(parser_t* parser) {
 
     match(parser, TOK_COLON);
 
-    token_t return_type = current(parser);
     if (!expect(parser, TOK_IDENTIFIER)) {
-        fprintf(stderr, LOCATION_FMT" ERROR: expected return type\n", LOCATION_ARG(current(parser).location));
-        exit(EXIT_FAILURE);
+        fprintf(parser->lexer->diagnostics, LOCATION_FMT" ERROR: expected return type\n", LOCATION_ARG(current_location(parser)));
+        fail(parser);
     }
+
+    parser->scratch[mark + FUNCTION_RETURN_TYPE] = ast_push(parser->ast, node_from(parser, NODE_NAME, current(parser)));
     advance(parser);
 
-    funsig->return_type = return_type.span;
+    node_id_t body = parse_block(parser);
+    parser->scratch[mark + FUNCTION_BODY] = body;
 
-    return funsig;
+    fundef.as.range = take_scratch(parser, mark);
+
+    return ast_push(parser->ast, fundef);
 }
 
-function_definition_t* parse_function_definition(parser_t* parser) {
-    location_t location = current(parser).location;
-    function_signature_t* funsig = parse_function_signature(parser);
-    block_t* body = parse_block(parser);
+node_id_t parse_translation_unit(parser_t* parser) {
+    node_t unit = node_from(parser, NODE_TRANSLATION_UNIT, current(parser));
+    size_t mark = dynarray_length(parser->scratch);
+
+    jmp_buf failure;
+    if (setjmp(failure)) {
+        parser->failure = NULL;
+        _dynarray_field_set(parser->scratch, LENGTH, mark);
+        return NODE_NONE;
+    }
+
+    parser->failure = &failure;
+
+    while (!is_eof(parser)) {
+        dynarray_push_rval(parser->scratch, parse_function_definition(parser));
+    }
+
+    parser->failure = NULL;
+    unit.as.range = take_scratch(parser, mark);
 
-    return function_definition_make(funsig, body, location);
+    return ast_push(parser->ast, unit);
 }
@@ -1,26 +1,58 @@
 #pragma once
 
 #include <ast.h>
+#include <lexer.h>
+#include <setjmp.h>
+#include <stdbool.h>
+#include <timing.h>
 #include <token.h>
 
+// Tokens pulled from the lexer at a time.
+#define PARSER_BATCH 256
+
+// Tokens are pulled from `lexer` as parsing goes, or read from `tokens` when
+// the input was lexed up front. The lexer always resolves locations.
 typedef struct {
-    token_t* tokens;
-    int cursor;
+    ast_t* ast;
+    node_id_t* scratch;
+
+    lexer_t* lexer;
+    token_buffer_t* tokens;
+    size_t next_token;
+
+    // Without `tokens`, the lexer is asked for a batch of tokens at a time,
+    // so a timed compile reads the clocks once per batch. `lexed` counts
+    // the tokens pulled and, if `timed`, `lex_time` is what lexing them took.
+    token_t batch[PARSER_BATCH];
+    uint32_t batch_next;
+    uint32_t batch_count;
+
+    size_t lexed;
+    bool timed;
+    pass_time_t lex_time;
+
+    // The current token, once it has been pulled.
+    token_t lookahead;
+    bool buffered;
+
+    // Where a syntax error unwinds to, or NULL to exit instead.
+    jmp_buf* failure;
 } parser_t;
 
-void parser_init(parser_t*, token_t*);
+void parser_init(parser_t*, lexer_t*, ast_t*);
+void parser_init_tokens(parser_t*, lexer_t*, token_buffer_t*, ast_t*);
 void parser_deinit(parser_t*);
 
-expression_t* parse_primary(parser_t*);
-expression_t* parse_factor(parser_t*);
-expression_t* parse_term(parser_t*);
-expression_t* parse_expression(parser_t*);
+node_id_t parse_primary(parser_t*);
+node_id_t parse_expression(parser_t*);
+
+node_id_t parse_block(parser_t*);
+node_id_t parse_let_assignment(parser_t*);
+node_id_t parse_return(parser_t*);
+node_id_t parse_statement(parser_t*);
 
-block_t* parse_block(parser_t*);
-let_assignment_t* parse_let_assignment(parser_t*);
-return_t* parse_return(parser_t*);
-statement_t* parse_statement(parser_t*);
+node_id_t parse_parameter(parser_t*);
+node_id_t parse_function_definition(parser_t*);
 
-parameter_t parse_parameter(parser_t*);
-function_signature_t* parse_function_signature(parser_t*);
-function_definition_t* parse_function_definition(parser_t*);
+// Returns NODE_NONE after reporting the first syntax error.
+node_id_t parse_translation_unit(parser_t*);
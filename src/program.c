@@ -0,0 +1,491 @@
+#include <alloc.h>
+#include <cache.h>
+#include <codegen.h>
+#include <compiler.h>
+#include <dynarray/dynarray.h>
+#include <fold.h>
+#include <program.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+
+// Where a function's code, calls and diagnostics ended up in the buffers of the
+// worker that compiled it.
+typedef struct {
+    int worker;
+    bool failed;
+
+    size_t code_begin;
+    size_t code_end;
+    size_t calls_begin;
+    size_t calls_end;
+    long diagnostics_begin;
+    long diagnostics_end;
+} function_output_t;
+
+typedef struct {
+    ast_t* ast;
+    compile_cache_t* cache;
+    node_range_t functions;
+    function_output_t* outputs;
+
+    program_worker_t* workers;
+    int threads;
+    bool timed;
+    atomic_size_t next;
+    atomic_int next_worker;
+} program_job_t;
+
+typedef compile_error_t (*function_pass_t)(compiler_t*, ast_t*, node_id_t);
+
+static const mem_tag_t pass_tags[PASS_COUNT] = {
+    [PASS_CHECK]   = MEM_SYMBOLS,
+    [PASS_FOLD]    = MEM_AST,
+    [PASS_CODEGEN] = MEM_CODEGEN,
+};
+
+static compile_error_t run_pass(program_job_t* job, program_worker_t* worker, pass_t pass, function_pass_t run, node_id_t fundef) {
+    mem_tag_t tag = mem_set_tag(pass_tags[pass]);
+
+    if (!job->timed) {
+        compile_error_t error = run(&worker->compiler, job->ast, fundef);
+        mem_set_tag(tag);
+        return error;
+    }
+
+    pass_clock_t start = pass_begin(true);
+    compile_error_t error = run(&worker->compiler, job->ast, fundef);
+    pass_end(&worker->report, pass, start);
+
+    mem_set_tag(tag);
+    return error;
+}
+
+static compile_error_t compile_function(program_job_t* job, program_worker_t* worker, node_id_t fundef) {
+    push_scope(&worker->compiler);
+
+    compile_error_t error = run_pass(job, worker, PASS_CHECK, compile_function_definition, fundef);
+    if (error == COMP_ERROR_OK) {
+        error = run_pass(job, worker, PASS_FOLD, fold_function_definition, fundef);
+    }
+    if (error == COMP_ERROR_OK) {
+        error = run_pass(job, worker, PASS_CODEGEN, codegen_function_definition, fundef);
+    }
+
+    pop_scope(&worker->compiler);
+
+    return error;
+}
+
+// The cache only holds assembly, where every line but a label is an
+// instruction.
+static uint64_t count_instructions(const char* code, size_t size) {
+    uint64_t count = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        count += code[i] == '\n' && (i == 0 || code[i - 1] != ':');
+    }
+
+    return count;
+}
+
+static void compile_body(program_job_t* job, int index, size_t i) {
+    program_worker_t* worker = &job->workers[index];
+    compiler_t* compiler = &worker->compiler;
+    function_output_t* output = &job->outputs[i];
+    x86_t* x86 = &compiler->x86;
+
+    output->worker = index;
+    output->code_begin = x86->code.size;
+    output->calls_begin = dynarray_length(x86->calls);
+    output->diagnostics_begin = ftell(compiler->diagnostics);
+
+    // A function whose signature was rejected has no entry to check against.
+    if (!output->failed) {
+        node_id_t fundef = ast_child(job->ast, job->functions, i);
+
+        cache_key_t key = job->cache ? compile_cache_key(compiler, job->ast, fundef) : (cache_key_t) { 0 };
+        bool cached = job->cache && compile_cache_load(job->cache, key, &x86->code);
+
+        if (cached) {
+            x86->instructions += count_instructions(x86->code.data + output->code_begin, x86->code.size - output->code_begin);
+        } else {
+            output->failed = compile_function(job, worker, fundef) != COMP_ERROR_OK;
+
+            if (job->cache && !output->failed) {
+                compile_cache_store(job->cache, key, x86->code.data + output->code_begin, x86->code.size - output->code_begin);
+            }
+        }
+    }
+
+    output->code_end = x86->code.size;
+    output->calls_end = dynarray_length(x86->calls);
+    output->diagnostics_end = ftell(compiler->diagnostics);
+}
+
+// Functions are handed out one at a time, so a worker that drew short ones
+// keeps taking more while another is busy with a long one.
+static void* program_worker(void* arg) {
+    program_job_t* job = arg;
+    int index = atomic_fetch_add(&job->next_worker, 1);
+    if (index >= job->threads) {
+        return NULL;
+    }
+
+    while (true) {
+        size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->functions.count) {
+            break;
+        }
+
+        compile_body(job, index, i);
+    }
+
+    return NULL;
+}
+
+static void* pool_thread(void* arg) {
+    program_pool_t* pool = arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (pool->generation == seen && !pool->stopping) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        program_worker(pool->job);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+// If a thread cannot be started, the ones that were share the work.
+static void pool_init(program_pool_t* pool, int threads) {
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->stopping = false;
+    pool->job = NULL;
+
+    pool->handles = mem_alloc(sizeof(pthread_t) * threads);
+    pool->started = 0;
+    while (pool->started < threads - 1 && pthread_create(&pool->handles[pool->started], NULL, pool_thread, pool) == 0) {
+        pool->started++;
+    }
+}
+
+static void pool_deinit(program_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->started; i++) {
+        pthread_join(pool->handles[i], NULL);
+    }
+
+    mem_free(pool->handles);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+// Runs the job on the parked threads and the calling one, and returns once
+// all of them are done with it.
+static void pool_run(program_pool_t* pool, program_job_t* job) {
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->busy = pool->started;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    program_worker(job);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void report_counters(program_t* program, int threads) {
+    for (int i = 0; i < threads; i++) {
+        program_worker_t* worker = &program->workers[i];
+        pass_report_merge(program->report, &worker->report);
+        program->report->lookups += worker->compiler.lookups;
+        program->report->instructions += worker->compiler.x86.instructions;
+        worker->compiler.lookups = 0;
+    }
+
+    program->report->lookups += program->compiler.lookups;
+    program->report->instructions += program->compiler.x86.instructions;
+    program->compiler.lookups = 0;
+}
+
+// Finds where each call's target ended up and stores the distance to it in
+// the call's rel32. `delta` takes an offset in the buffer the calls were
+// made in to one in the linked code.
+static void patch_calls(program_t* program, emitter_t* output, size_t base, const uint32_t* addresses, const x86_call_t* calls, size_t begin, size_t end, int64_t delta) {
+    for (size_t i = begin; i < end; i++) {
+        uint32_t at = calls[i].offset + delta;
+        uint32_t target = addresses[symbol_map_get(&program->compiler.functions->index, calls[i].target)];
+        uint32_t relative = target - (at + 4);
+
+        char bytes[4] = { relative, relative >> 8, relative >> 16, relative >> 24 };
+        memcpy(output->data + base + at, bytes, sizeof(bytes));
+    }
+}
+
+// Executables start with a stub that calls main and exits with its result,
+// or with 0 if main returns nothing.
+static void emit_entry_point(program_t* program, x86_t* x86) {
+    x86_call(x86, SYMBOL_MAIN, sv_make_from("main"));
+    if (!program->main.returns_value) {
+        x86_mov_immediate(x86, REG_RDI, 0);
+    } else {
+        x86_mov(x86, REG_RDI, REG_RAX);
+    }
+    x86_mov_immediate(x86, REG_RAX, SYS_exit);
+    x86_syscall(x86);
+}
+
+// Looks main up once for the entry point and for whoever runs the code.
+// Executables and code run in process cannot do without it.
+static bool find_main(program_t* program) {
+    function_table_t* functions = program->compiler.functions;
+    uint32_t main = symbol_map_get(&functions->index, SYMBOL_MAIN);
+
+    program->main = (program_entry_t) {
+        .found = main != SYMBOL_MAP_NONE,
+        .returns_value = main != SYMBOL_MAP_NONE && functions->functions[main]->return_type != TYPE_VOID,
+    };
+
+    if (!program->main.found && program->format == OUTPUT_EXECUTABLE) {
+        fprintf(program->compiler.diagnostics, "ERROR: an executable needs a 'main' function\n");
+        return false;
+    }
+
+    if (!program->main.found && program->format == OUTPUT_MACHINE_CODE) {
+        fprintf(program->compiler.diagnostics, "ERROR: running a program needs a 'main' function\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Lays the functions' machine code out in source order behind the entry
+// point, if any, and points every call at its target.
+static bool link_program(program_t* program, ast_t* ast, node_range_t functions, function_output_t* outputs, emitter_t* output) {
+    x86_t* start = &program->compiler.x86;
+    x86_clear(start);
+    start->encode = true;
+
+    if (!find_main(program)) {
+        return false;
+    }
+
+    if (program->format == OUTPUT_EXECUTABLE) {
+        emit_entry_point(program, start);
+    }
+
+    size_t file = output->size;
+    if (program->format == OUTPUT_EXECUTABLE) {
+        file = elf64_begin_executable(output);
+    } else if (program->format == OUTPUT_OBJECT) {
+        file = elf64_begin_object(output);
+    }
+
+    size_t base = output->size;
+
+    _dynarray_field_set(program->symbols, LENGTH, 0);
+    uint32_t* addresses = mem_alloc(sizeof(uint32_t) * (functions.count ? functions.count : 1));
+
+    emit_bytes(output, start->code.data, start->code.size);
+
+    for (uint32_t i = 0; i < functions.count; i++) {
+        function_output_t* function = &outputs[i];
+        x86_t* x86 = &program->workers[function->worker].compiler.x86;
+        node_id_t name = ast_function_first(ast, ast_child(ast, functions, i));
+
+        elf64_symbol_t symbol = {
+            .name = ast_name(ast, name),
+            .offset = output->size - base,
+            .size = function->code_end - function->code_begin,
+        };
+        dynarray_push(program->symbols, symbol);
+
+        symbol_t function_name = ast_node(ast, name)->symbol;
+        addresses[symbol_map_get(&program->compiler.functions->index, function_name)] = symbol.offset;
+        if (function_name == SYMBOL_MAIN) {
+            program->main.offset = symbol.offset;
+        }
+        emit_bytes(output, x86->code.data + function->code_begin, symbol.size);
+    }
+
+    patch_calls(program, output, base, addresses, start->calls, 0, dynarray_length(start->calls), 0);
+
+    for (uint32_t i = 0; i < functions.count; i++) {
+        function_output_t* function = &outputs[i];
+        x86_t* x86 = &program->workers[function->worker].compiler.x86;
+
+        int64_t delta = (int64_t) program->symbols[i].offset - (int64_t) function->code_begin;
+        patch_calls(program, output, base, addresses, x86->calls, function->calls_begin, function->calls_end, delta);
+    }
+
+    mem_free(addresses);
+
+    if (program->format == OUTPUT_EXECUTABLE) {
+        elf64_finish_executable(output, file, 0);
+    } else if (program->format == OUTPUT_OBJECT) {
+        elf64_finish_object(output, file, program->symbols, dynarray_length(program->symbols));
+    }
+
+    return true;
+}
+
+void program_init(program_t* program, int threads) {
+    mem_tag_t tag = mem_set_tag(MEM_SYMBOLS);
+
+    compiler_init(&program->compiler);
+    program->threads = threads;
+    program->report = NULL;
+    program->format = OUTPUT_ASSEMBLY;
+    program->symbols = dynarray_create(elf64_symbol_t);
+    program->main = (program_entry_t) { .found = false };
+    program->workers = mem_alloc(sizeof(program_worker_t) * threads);
+
+    for (int i = 0; i < threads; i++) {
+        program_worker_t* worker = &program->workers[i];
+        compiler_init_worker(&worker->compiler, &program->compiler);
+        worker->compiler.diagnostics = open_memstream(&worker->diagnostics, &worker->diagnostics_size);
+    }
+
+    pool_init(&program->pool, threads);
+
+    mem_set_tag(tag);
+}
+
+void program_deinit(program_t* program) {
+    pool_deinit(&program->pool);
+
+    for (int i = 0; i < program->threads; i++) {
+        program_worker_t* worker = &program->workers[i];
+        fclose(worker->compiler.diagnostics);
+        compiler_deinit(&worker->compiler);
+        free(worker->diagnostics);
+    }
+
+    mem_free(program->workers);
+    dynarray_destroy(program->symbols);
+    compiler_deinit(&program->compiler);
+}
+
+bool compile_program(program_t* program, ast_t* ast, node_id_t unit, compile_cache_t* cache, emitter_t* output, FILE* diagnostics) {
+    node_range_t functions = ast_node(ast, unit)->as.range;
+
+    compiler_reset(&program->compiler);
+    program->compiler.diagnostics = diagnostics;
+
+    function_output_t* outputs = mem_calloc(functions.count ? functions.count : 1, sizeof(function_output_t));
+
+    pass_clock_t start = pass_begin(false);
+    mem_tag_t tag = mem_set_tag(MEM_SYMBOLS);
+
+    // Signatures are collected up front so a body may call any function,
+    // and the function table is read-only from here on.
+    bool failed = false;
+    for (uint32_t i = 0; i < functions.count; i++) {
+        if (compile_function_signature(&program->compiler, ast, ast_child(ast, functions, i)) != COMP_ERROR_OK) {
+            outputs[i].failed = true;
+            failed = true;
+        }
+    }
+
+    mem_set_tag(tag);
+
+    if (program->report) {
+        pass_end(program->report, PASS_SIGNATURES, start);
+    }
+
+    int threads = program->threads;
+    if (threads > (int) functions.count) {
+        threads = functions.count ? functions.count : 1;
+    }
+
+    // Each compile starts at the beginning of the workers' buffers.
+    x86_clear(&program->compiler.x86);
+    for (int i = 0; i < threads; i++) {
+        x86_clear(&program->workers[i].compiler.x86);
+        program->workers[i].compiler.x86.encode = program->format != OUTPUT_ASSEMBLY;
+        rewind(program->workers[i].compiler.diagnostics);
+        pass_report_init(&program->workers[i].report);
+    }
+
+    // Encoded calls are patched from their x86_call_t when linking, and the
+    // cache keeps only the code, so it is left out of machine code builds.
+    program_job_t job = {
+        .ast = ast,
+        .cache = program->format == OUTPUT_ASSEMBLY ? cache : NULL,
+        .functions = functions,
+        .outputs = outputs,
+        .workers = program->workers,
+        .threads = threads,
+        .timed = program->report != NULL,
+    };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.next_worker, 0);
+
+    pool_run(&program->pool, &job);
+
+    for (int i = 0; i < threads; i++) {
+        fflush(program->workers[i].compiler.diagnostics);
+    }
+
+    for (uint32_t i = 0; i < functions.count; i++) {
+        function_output_t* function = &outputs[i];
+        program_worker_t* worker = &job.workers[function->worker];
+
+        fwrite(worker->diagnostics + function->diagnostics_begin, 1, function->diagnostics_end - function->diagnostics_begin, diagnostics);
+        failed = failed || function->failed;
+    }
+
+    start = pass_begin(false);
+
+    if (!failed && program->format == OUTPUT_ASSEMBLY) {
+        for (uint32_t i = 0; i < functions.count; i++) {
+            function_output_t* function = &outputs[i];
+            program_worker_t* worker = &job.workers[function->worker];
+
+            emit_bytes(output, worker->compiler.x86.code.data + function->code_begin, function->code_end - function->code_begin);
+        }
+    } else if (!failed) {
+        failed = !link_program(program, ast, functions, outputs, output);
+    }
+
+    if (program->report) {
+        pass_end(program->report, PASS_OUTPUT, start);
+        report_counters(program, threads);
+    }
+
+    mem_free(outputs);
+
+    return !failed;
+}
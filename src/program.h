@@ -0,0 +1,81 @@
+#pragma once
+
+#include <ast.h>
+#include <cache.h>
+#include <compiler.h>
+#include <elf64.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <timing.h>
+
+typedef struct {
+    compiler_t compiler;
+
+    char* diagnostics;
+    size_t diagnostics_size;
+
+    pass_report_t report;
+} program_worker_t;
+
+// Assembly is NASM text; the other formats are machine code that the
+// program links itself.
+typedef enum {
+    OUTPUT_ASSEMBLY,
+    OUTPUT_OBJECT,
+    OUTPUT_EXECUTABLE,
+
+    // The linked code alone, to be run in the compiler's own process.
+    OUTPUT_MACHINE_CODE,
+} output_format_t;
+
+// Where main ended up in the last machine code output, if there is one.
+typedef struct {
+    bool found;
+    bool returns_value;
+    uint32_t offset;
+} program_entry_t;
+
+// Threads parked between compiles. Each compile bumps `generation` and
+// wakes them; the last one to finish signals `done`.
+typedef struct {
+    pthread_t* handles;
+    int started;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    uint64_t generation;
+    int busy;
+    bool stopping;
+    void* job;
+} program_pool_t;
+
+// The program's compiler and its workers, with their buffers and threads,
+// are kept between compiles so a long-running process does not rebuild
+// them. Phases are timed into `report` unless it is NULL.
+typedef struct {
+    compiler_t compiler;
+
+    program_worker_t* workers;
+    int threads;
+    program_pool_t pool;
+
+    pass_report_t* report;
+    output_format_t format;
+
+    // Where each function ended up in the last machine code output.
+    elf64_symbol_t* symbols;
+    program_entry_t main;
+} program_t;
+
+void program_init(program_t*, int);
+void program_deinit(program_t*);
+
+// Collects every signature, then checks and emits the function bodies on
+// the program's workers. The output is appended to `output` in source
+// order and only if the whole program compiled; diagnostics go to
+// `diagnostics` in source order either way. With a cache, functions whose
+// entry is found are not checked or emitted again.
+bool compile_program(program_t*, ast_t*, node_id_t, compile_cache_t*, emitter_t*, FILE*);
@@ -0,0 +1,38 @@
+#include <errno.h>
+#include <protocol.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+const char* protocol_socket_path(const char* path) {
+    if (path) {
+        return path;
+    }
+
+    const char* env = getenv(PROTOCOL_SOCKET_ENV);
+    return env && *env ? env : PROTOCOL_DEFAULT_SOCKET;
+}
+
+int protocol_connect(const char* path) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "ERROR: socket path '%s' is too long\n", path);
+        return -1;
+    }
+
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*) &address, sizeof(address)) < 0) {
+        fprintf(stderr, "ERROR: cannot connect to '%s': %s\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    return fd;
+}
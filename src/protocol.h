@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The server and its clients talk over a Unix domain socket. A connection
+// carries any number of requests, each answered before the next is read.
+// A request is a request_header_t followed by the source; a reply is a
+// reply_header_t followed by the code and then the diagnostics.
+#define PROTOCOL_MAGIC 0x4B554431u  // "DUK1"
+#define PROTOCOL_SOCKET_ENV "DUKTAPE_SOCKET"
+#define PROTOCOL_DEFAULT_SOCKET "/tmp/duktape.sock"
+
+// Larger requests are refused before anything is allocated for them.
+#define PROTOCOL_MAX_SOURCE_SIZE (256u << 20)
+
+// What a request asks the server to emit. The default is whatever the
+// server was started with.
+typedef enum {
+    PROTOCOL_EMIT_DEFAULT,
+    PROTOCOL_EMIT_ASSEMBLY,
+    PROTOCOL_EMIT_OBJECT,
+    PROTOCOL_EMIT_EXECUTABLE,
+    PROTOCOL_EMIT_COUNT,
+} protocol_emit_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t emit;
+    uint64_t source_size;
+} request_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t compiled;
+    uint64_t code_size;
+    uint64_t diagnostics_size;
+} reply_header_t;
+
+// `path` if it is set, else $DUKTAPE_SOCKET, else the default.
+const char* protocol_socket_path(const char*);
+
+// Returns a connected socket, or -1 after reporting why not.
+int protocol_connect(const char*);
@@ -0,0 +1,256 @@
+#include <alloc.h>
+#include <dynarray/dynarray.h>
+#include <regalloc.h>
+
+const reg_t argument_regs[ARGUMENT_REG_COUNT] = { REG_RDI, REG_RSI, REG_RDX, REG_RCX, REG_R8, REG_R9 };
+
+// rsi and rdi come last, so shallow expressions leave them to the
+// parameters that arrive in them.
+const reg_t temp_regs[TEMP_REG_COUNT] = { REG_RAX, REG_RCX, REG_RDX, REG_R8, REG_R9, REG_R10, REG_R11, REG_RSI, REG_RDI };
+
+const reg_t callee_saved_regs[CALLEE_SAVED_REG_COUNT] = { REG_RBX, REG_R12, REG_R13, REG_R14, REG_R15 };
+
+// A variable is live from `start`, where it is defined, to `end`, its last
+// use; both are node ids. Parameters start at the function's first node.
+typedef struct {
+    node_id_t start;
+    node_id_t end;
+    bool crosses_call;
+    reg_t hint;
+} interval_t;
+
+typedef struct {
+    compiler_t* compiler;
+    ast_t* ast;
+    node_id_t first;
+
+    // The function's variables are compiler->vars from `mark` on.
+    size_t mark;
+    size_t count;
+    interval_t* intervals;
+
+    // Calls among the function's nodes before first + i.
+    uint32_t* calls;
+    int max_depth;
+} liveness_t;
+
+static interval_t* interval_of(liveness_t* liveness, symbol_t name) {
+    compiled_var_t* var = find_variable(liveness->compiler, name);
+    return &liveness->intervals[var - liveness->compiler->vars - liveness->mark];
+}
+
+// Walks the body in the order codegen emits it, tracking how deep the
+// expression stack gets as well as where each variable is defined and used.
+static void compute_liveness(liveness_t* liveness, node_id_t fundef) {
+    ast_t* ast = liveness->ast;
+    int depth = 0;
+
+    liveness->calls[0] = 0;
+
+    for (node_id_t id = liveness->first; id < fundef; id++) {
+        node_t* node = ast_node(ast, id);
+        uint32_t* calls = &liveness->calls[id - liveness->first];
+        calls[1] = calls[0];
+
+        switch (node->kind) {
+            case NODE_INTEGER:
+            case NODE_BOOLEAN:
+                depth++;
+                break;
+            case NODE_IDENTIFIER:
+                interval_of(liveness, node->symbol)->end = id;
+                depth++;
+                break;
+            case NODE_FUNCALL:
+                depth -= (int) node->as.range.count - 1;
+                calls[1]++;
+                break;
+            case NODE_BINARY:
+                depth--;
+                break;
+            case NODE_LET_ASSIGNMENT: {
+                interval_t* interval = interval_of(liveness, ast_node(ast, node->as.pair.lhs)->symbol);
+                interval->start = id;
+                interval->end = id;
+                depth = 0;
+                break;
+            }
+            case NODE_RETURN:
+                depth = 0;
+                break;
+            default:
+                break;
+        }
+
+        if (depth > liveness->max_depth) {
+            liveness->max_depth = depth;
+        }
+    }
+
+    for (size_t i = 0; i < liveness->count; i++) {
+        interval_t* interval = &liveness->intervals[i];
+        uint32_t before = liveness->calls[interval->start - liveness->first + 1];
+        interval->crosses_call = liveness->calls[interval->end - liveness->first] > before;
+    }
+}
+
+static bool is_callee_saved(reg_t reg) {
+    for (int i = 0; i < CALLEE_SAVED_REG_COUNT; i++) {
+        if (callee_saved_regs[i] == reg) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Temporaries own the first temp_count temporary registers outright; the
+// rest are free for variables that are not live across a call.
+static bool may_take(int temp_count, interval_t* interval, reg_t reg) {
+    if (is_callee_saved(reg)) {
+        return true;
+    }
+
+    for (int i = 0; i < temp_count; i++) {
+        if (temp_regs[i] == reg) {
+            return false;
+        }
+    }
+
+    return !interval->crosses_call;
+}
+
+static reg_t pick_register(int temp_count, interval_t* interval, const bool* taken) {
+    if (interval->hint != REG_NONE && !taken[interval->hint] && may_take(temp_count, interval, interval->hint)) {
+        return interval->hint;
+    }
+
+    if (!interval->crosses_call) {
+        for (int i = temp_count; i < TEMP_REG_COUNT; i++) {
+            if (!taken[temp_regs[i]]) {
+                return temp_regs[i];
+            }
+        }
+    }
+
+    for (int i = 0; i < CALLEE_SAVED_REG_COUNT; i++) {
+        if (!taken[callee_saved_regs[i]]) {
+            return callee_saved_regs[i];
+        }
+    }
+
+    return REG_NONE;
+}
+
+static void linear_scan(liveness_t* liveness, int temp_count) {
+    compiled_var_t* vars = &liveness->compiler->vars[liveness->mark];
+    interval_t* intervals = liveness->intervals;
+
+    bool taken[REG_COUNT] = { 0 };
+    size_t* active = mem_alloc(sizeof(size_t) * (liveness->count ? liveness->count : 1));
+    size_t active_count = 0;
+
+    for (size_t i = 0; i < liveness->count; i++) {
+        interval_t* interval = &intervals[i];
+
+        for (size_t j = 0; j < active_count;) {
+            if (intervals[active[j]].end < interval->start) {
+                taken[vars[active[j]].reg] = false;
+                active[j] = active[--active_count];
+            } else {
+                j++;
+            }
+        }
+
+        vars[i].reg = pick_register(temp_count, interval, taken);
+        if (vars[i].reg != REG_NONE) {
+            taken[vars[i].reg] = true;
+            active[active_count++] = i;
+            continue;
+        }
+
+        // Out of registers: whichever of this variable and the active ones
+        // it could take a register from lives longest goes to the stack.
+        size_t victim = active_count;
+        for (size_t j = 0; j < active_count; j++) {
+            size_t candidate = active[j];
+            if (may_take(temp_count, interval, vars[candidate].reg) && (victim == active_count || intervals[candidate].end > intervals[active[victim]].end)) {
+                victim = j;
+            }
+        }
+
+        if (victim < active_count && intervals[active[victim]].end > interval->end) {
+            vars[i].reg = vars[active[victim]].reg;
+            vars[active[victim]].reg = REG_NONE;
+            active[victim] = i;
+        }
+    }
+
+    mem_free(active);
+}
+
+void allocate_registers(compiler_t* compiler, ast_t* ast, node_id_t fundef) {
+    size_t mark = compiler->scopes[dynarray_length(compiler->scopes) - 1];
+
+    liveness_t liveness = {
+        .compiler = compiler,
+        .ast = ast,
+        .first = ast_function_first(ast, fundef),
+        .mark = mark,
+        .count = dynarray_length(compiler->vars) - mark,
+    };
+
+    compiled_function_t* fun = find_function(compiler, ast_node(ast, liveness.first)->symbol);
+    size_t parameters = dynarray_length(fun->parameters);
+
+    liveness.intervals = mem_alloc(sizeof(interval_t) * (liveness.count ? liveness.count : 1));
+    liveness.calls = mem_alloc(sizeof(uint32_t) * (fundef - liveness.first + 1));
+
+    for (size_t i = 0; i < liveness.count; i++) {
+        liveness.intervals[i] = (interval_t) {
+            .start = liveness.first,
+            .end = liveness.first,
+            .hint = i < parameters && i < ARGUMENT_REG_COUNT ? argument_regs[i] : REG_NONE,
+        };
+    }
+
+    compute_liveness(&liveness, fundef);
+
+    register_allocation_t* registers = &compiler->registers;
+    registers->temp_count = liveness.max_depth < 1 ? 1 : liveness.max_depth < TEMP_REG_COUNT ? liveness.max_depth : TEMP_REG_COUNT;
+    registers->temp_depth = 0;
+
+    linear_scan(&liveness, registers->temp_count);
+
+    // Spilled variables are packed at the top of the frame, followed by a
+    // slot for each temporary that is ever spilled.
+    int frame_size = 0;
+    registers->saved = 0;
+
+    for (size_t i = 0; i < liveness.count; i++) {
+        compiled_var_t* var = &compiler->vars[mark + i];
+
+        if (var->reg == REG_NONE) {
+            var->address = frame_size;
+            frame_size += type_info(compiler->types, var->type)->size;
+        } else if (is_callee_saved(var->reg)) {
+            registers->saved |= 1u << var->reg;
+        }
+    }
+
+    frame_size = (frame_size + 7) & ~7;
+    registers->spill_offset = frame_size;
+
+    if (liveness.max_depth > registers->temp_count) {
+        frame_size += 8 * (liveness.max_depth - registers->temp_count);
+    }
+
+    // rbp and the saved registers are pushed before the frame is made, so
+    // it is padded to bring rsp back to a 16-byte boundary.
+    int saved_size = 8 * __builtin_popcount(registers->saved);
+    registers->frame_size = ((frame_size + saved_size + 15) & ~15) - saved_size;
+    registers->framed = frame_size > 0 || registers->saved != 0 || liveness.calls[fundef - liveness.first] > 0;
+
+    mem_free(liveness.calls);
+    mem_free(liveness.intervals);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <compiler.h>
+
+// Integer arguments in System V order.
+extern const reg_t argument_regs[];
+#define ARGUMENT_REG_COUNT 6
+
+// Registers expression temporaries rotate through, and the callee-saved
+// registers locals may take, in the order they are handed out.
+extern const reg_t temp_regs[];
+#define TEMP_REG_COUNT 9
+
+extern const reg_t callee_saved_regs[];
+#define CALLEE_SAVED_REG_COUNT 5
+
+// Places every parameter and let of the function in a register or a stack
+// slot and fills compiler->registers. Bodies have no control flow, so a
+// variable is live from its definition to its last use in node order, and
+// the variables are allocated by linear scan over those intervals. One that
+// is live across a call only gets a callee-saved register; when none is
+// left, the interval ending last is spilled to the stack.
+//
+// Runs after folding, on the scope the body was checked in.
+void allocate_registers(compiler_t*, ast_t*, node_id_t);
@@ -0,0 +1,174 @@
+#include <common.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <protocol.h>
+#include <server.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Connections are served one at a time, so a client that stops reading or
+// writing mid-request would hold off every other. Its connection is dropped
+// once a transfer stalls this long.
+#define SERVER_IO_TIMEOUT_SECONDS 10
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int signal) {
+    (void) signal;
+    stopping = 1;
+}
+
+static const output_format_t emit_formats[PROTOCOL_EMIT_COUNT] = {
+    [PROTOCOL_EMIT_ASSEMBLY]   = OUTPUT_ASSEMBLY,
+    [PROTOCOL_EMIT_OBJECT]     = OUTPUT_OBJECT,
+    [PROTOCOL_EMIT_EXECUTABLE] = OUTPUT_EXECUTABLE,
+};
+
+// Buffers reused from one request to the next, and what a request that
+// leaves the format to the server gets.
+typedef struct {
+    output_format_t format;
+
+    char* source;
+    size_t source_capacity;
+
+    emitter_t output;
+
+    char* diagnostics;
+    size_t diagnostics_size;
+    FILE* diagnostics_stream;
+} server_buffers_t;
+
+static bool serve_request(session_t* session, server_buffers_t* buffers, int fd) {
+    request_header_t request;
+    if (!read_all(fd, &request, sizeof(request))) {
+        return false;
+    }
+
+    if (request.magic != PROTOCOL_MAGIC || request.emit >= PROTOCOL_EMIT_COUNT) {
+        fprintf(stderr, "ERROR: bad request from client\n");
+        return false;
+    }
+
+    if (request.source_size > PROTOCOL_MAX_SOURCE_SIZE) {
+        fprintf(stderr, "ERROR: refusing a %"PRIu64" byte source; the limit is %u bytes\n", request.source_size, PROTOCOL_MAX_SOURCE_SIZE);
+        return false;
+    }
+
+    if (request.source_size > buffers->source_capacity) {
+        char* source = realloc(buffers->source, request.source_size);
+        if (!source) {
+            fprintf(stderr, "ERROR: cannot allocate %"PRIu64" bytes for a source\n", request.source_size);
+            return false;
+        }
+
+        buffers->source = source;
+        buffers->source_capacity = request.source_size;
+    }
+
+    if (!read_all(fd, buffers->source, request.source_size)) {
+        return false;
+    }
+
+    emitter_clear(&buffers->output);
+    rewind(buffers->diagnostics_stream);
+
+    session->program.format = request.emit == PROTOCOL_EMIT_DEFAULT ? buffers->format : emit_formats[request.emit];
+
+    bool compiled = session_compile(session, buffers->source, request.source_size, &buffers->output, buffers->diagnostics_stream);
+    session_trim(session);
+
+    long diagnostics_size = ftell(buffers->diagnostics_stream);
+    fflush(buffers->diagnostics_stream);
+
+    reply_header_t reply = {
+        .magic = PROTOCOL_MAGIC,
+        .compiled = compiled,
+        .code_size = buffers->output.size,
+        .diagnostics_size = diagnostics_size,
+    };
+
+    return write_all(fd, &reply, sizeof(reply))
+        && emitter_write(&buffers->output, fd)
+        && write_all(fd, buffers->diagnostics, diagnostics_size);
+}
+
+static int listen_on(const char* path) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "ERROR: socket path '%s' is too long\n", path);
+        return -1;
+    }
+
+    strcpy(address.sun_path, path);
+
+    // A socket left behind by a server that did not shut down cleanly.
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*) &address, sizeof(address)) < 0 || listen(fd, 64) < 0) {
+        fprintf(stderr, "ERROR: cannot listen on '%s': %s\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    return fd;
+}
+
+bool run_server(session_t* session, const char* path) {
+    int listener = listen_on(path);
+    if (listener < 0) {
+        return false;
+    }
+
+    // Without SA_RESTART a signal interrupts accept() and read(), so the
+    // loops below notice `stopping`.
+    struct sigaction action = { .sa_handler = stop };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    server_buffers_t buffers = { .format = session->program.format };
+    emitter_init(&buffers.output);
+    buffers.diagnostics_stream = open_memstream(&buffers.diagnostics, &buffers.diagnostics_size);
+
+    while (!stopping) {
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: cannot accept on '%s': %s\n", path, strerror(errno));
+            break;
+        }
+
+        struct timeval timeout = { .tv_sec = SERVER_IO_TIMEOUT_SECONDS };
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        while (!stopping && serve_request(session, &buffers, connection)) {
+        }
+
+        close(connection);
+    }
+
+    fclose(buffers.diagnostics_stream);
+    emitter_deinit(&buffers.output);
+    free(buffers.diagnostics);
+    free(buffers.source);
+
+    close(listener);
+    unlink(path);
+
+    return stopping;
+}
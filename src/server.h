@@ -0,0 +1,9 @@
+#pragma once
+
+#include <session.h>
+#include <stdbool.h>
+
+// Serves compile requests on a Unix domain socket at `path` until SIGINT or
+// SIGTERM, one connection at a time, all through the same session. A
+// connection that sits idle or stalls mid-transfer for ten seconds is closed.
+bool run_server(session_t*, const char*);
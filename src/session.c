@@ -0,0 +1,97 @@
+#include <alloc.h>
+#include <dynarray/dynarray.h>
+#include <lexer.h>
+#include <parser.h>
+#include <session.h>
+
+// Names and fresh cache entries a session keeps before session_trim lets
+// go of them.
+#define SESSION_MAX_SYMBOLS (1u << 20)
+#define SESSION_MAX_FRESH_ENTRIES (1u << 16)
+
+void session_init(session_t* session, int threads, compile_cache_t* cache, pass_report_t* report, output_format_t format) {
+    interner_init(&session->interner);
+    program_init(&session->program, threads);
+    session->program.report = report;
+    session->program.format = format;
+    session->cache = cache;
+    session->report = report;
+    session->threads = threads;
+}
+
+void session_deinit(session_t* session) {
+    program_deinit(&session->program);
+    interner_deinit(&session->interner);
+}
+
+// Symbol ids only mean something within one compile, and the cache keys
+// functions by name rather than id, so starting the interner over is safe.
+void session_trim(session_t* session) {
+    if (interner_count(&session->interner) > SESSION_MAX_SYMBOLS) {
+        interner_deinit(&session->interner);
+        interner_init(&session->interner);
+    }
+
+    if (session->cache && dynarray_length(session->cache->fresh) > SESSION_MAX_FRESH_ENTRIES) {
+        compile_cache_flush(session->cache);
+    }
+}
+
+bool session_compile(session_t* session, const char* data, size_t size, emitter_t* output, FILE* diagnostics) {
+    mem_tag_t tag = mem_set_tag(MEM_LEXER);
+
+    lexer_t lexer;
+    lexer_init(&lexer, data, size);
+    lexer.interner = &session->interner;
+    lexer.diagnostics = diagnostics;
+
+    // With more than one thread the whole input is lexed up front in
+    // parallel; otherwise the parser pulls batches of tokens as it goes,
+    // and a timed compile charges the time spent lexing them to lexing
+    // rather than parsing.
+    token_buffer_t tokens;
+    token_buffer_init(&tokens);
+
+    parser_t parser;
+    ast_t ast;
+
+    if (session->threads > 1) {
+        pass_clock_t start = pass_begin(false);
+        get_tokens_parallel(&lexer, &tokens, session->threads);
+
+        if (session->report) {
+            pass_end(session->report, PASS_LEX, start);
+            session->report->tokens += token_buffer_length(&tokens);
+        }
+
+        mem_set_tag(MEM_AST);
+        ast_init(&ast, &lexer);
+        parser_init_tokens(&parser, &lexer, &tokens, &ast);
+    } else {
+        mem_set_tag(MEM_AST);
+        ast_init(&ast, &lexer);
+        parser_init(&parser, &lexer, &ast);
+        parser.timed = session->report != NULL;
+    }
+
+    pass_clock_t start = pass_begin(false);
+    node_id_t unit = parse_translation_unit(&parser);
+
+    if (session->report) {
+        pass_end(session->report, PASS_PARSE, start);
+        pass_move(session->report, PASS_PARSE, PASS_LEX, parser.lex_time);
+        session->report->tokens += parser.lexed;
+        session->report->nodes += dynarray_length(ast.nodes);
+    }
+
+    mem_set_tag(tag);
+
+    bool compiled = unit != NODE_NONE && compile_program(&session->program, &ast, unit, session->cache, output, diagnostics);
+
+    parser_deinit(&parser);
+    ast_deinit(&ast);
+    token_buffer_deinit(&tokens);
+    lexer_deinit(&lexer);
+
+    return compiled;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cache.h>
+#include <interner.h>
+#include <program.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <timing.h>
+
+// Everything that outlives a single compile: identifiers stay interned, the
+// program's workers keep their buffers and the cache stays open. Every
+// compile is timed into `report` unless it is NULL.
+typedef struct {
+    interner_t interner;
+    program_t program;
+    compile_cache_t* cache;
+    pass_report_t* report;
+    int threads;
+} session_t;
+
+void session_init(session_t*, int, compile_cache_t*, pass_report_t*, output_format_t);
+void session_deinit(session_t*);
+
+// Lets go of what earlier compiles left behind once it passes a bound, so
+// a long-lived session does not grow without limit: the interned names are
+// dropped and the cache's fresh entries are written to its pack.
+void session_trim(session_t*);
+
+// Compiles a whole source file and returns whether it compiled. The output
+// is only appended to `output` if it did.
+bool session_compile(session_t*, const char*, size_t, emitter_t*, FILE*);
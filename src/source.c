@@ -0,0 +1,118 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <source.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Fails with errno set, which the caller reports. This file is also built
+// into the client, which does not link the allocator, so it checks malloc
+// itself.
+static bool read_stream(source_t* source, int fd) {
+    size_t capacity = 4096;
+    size_t size = 0;
+    char* buffer = malloc(capacity);
+
+    if (!buffer) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    while (true) {
+        if (size == capacity) {
+            char* grown = realloc(buffer, capacity * 2);
+            if (!grown) {
+                free(buffer);
+                errno = ENOMEM;
+                return false;
+            }
+
+            buffer = grown;
+            capacity *= 2;
+        }
+
+        ssize_t n = read(fd, buffer + size, capacity - size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            free(buffer);
+            return false;
+        }
+
+        if (n == 0) {
+            break;
+        }
+
+        size += n;
+    }
+
+    source->data = buffer;
+    source->size = size;
+    source->mapped = false;
+
+    return true;
+}
+
+bool source_open(source_t* source, const char* filepath) {
+    source->data = NULL;
+    source->size = 0;
+    source->mapped = false;
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: cannot open file '%s': %s\n", filepath, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        fprintf(stderr, "ERROR: cannot stat file '%s': %s\n", filepath, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    if (S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) {
+            close(fd);
+            return true;
+        }
+
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+            source->data = data;
+            source->size = st.st_size;
+            source->mapped = true;
+
+            close(fd);
+            return true;
+        }
+    }
+
+    if (!read_stream(source, fd)) {
+        fprintf(stderr, "ERROR: cannot read file '%s': %s\n", filepath, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    close(fd);
+    return true;
+}
+
+void source_close(source_t* source) {
+    if (source->mapped) {
+        munmap((void*) source->data, source->size);
+    } else {
+        free((void*) source->data);
+    }
+
+    source->data = NULL;
+    source->size = 0;
+    source->mapped = false;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bytes of a source file. Regular files are mapped read-only, so tokens can
+// point straight into the mapping; anything else is read into memory.
+typedef struct {
+    const char* data;
+    size_t size;
+    bool mapped;
+} source_t;
+
+bool source_open(source_t*, const char*);
+void source_close(source_t*);
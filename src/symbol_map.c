@@ -0,0 +1,117 @@
+#include <alloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <symbol_map.h>
+
+#define SYMBOL_MAP_INITIAL_BITS 6
+
+static size_t home_slot(symbol_map_t* map, symbol_t symbol) {
+    return (uint32_t) (symbol * 2654435769u) >> map->shift;
+}
+
+static void allocate(symbol_map_t* map, int bits) {
+    map->capacity = (size_t) 1 << bits;
+    map->count = 0;
+    map->shift = 32 - bits;
+
+    map->keys = mem_alloc(sizeof(symbol_t) * map->capacity);
+    map->values = mem_alloc(sizeof(uint32_t) * map->capacity);
+    memset(map->keys, 0xFF, sizeof(symbol_t) * map->capacity);
+}
+
+void symbol_map_init(symbol_map_t* map) {
+    allocate(map, SYMBOL_MAP_INITIAL_BITS);
+}
+
+void symbol_map_deinit(symbol_map_t* map) {
+    mem_free(map->keys);
+    mem_free(map->values);
+}
+
+void symbol_map_clear(symbol_map_t* map) {
+    memset(map->keys, 0xFF, sizeof(symbol_t) * map->capacity);
+    map->count = 0;
+}
+
+static size_t find_slot(symbol_map_t* map, symbol_t symbol) {
+    size_t mask = map->capacity - 1;
+    size_t slot = home_slot(map, symbol);
+
+    while (map->keys[slot] != SYMBOL_NONE && map->keys[slot] != symbol) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void grow(symbol_map_t* map) {
+    symbol_t* keys = map->keys;
+    uint32_t* values = map->values;
+    size_t capacity = map->capacity;
+
+    allocate(map, 32 - map->shift + 1);
+
+    for (size_t i = 0; i < capacity; i++) {
+        if (keys[i] != SYMBOL_NONE) {
+            size_t slot = find_slot(map, keys[i]);
+            map->keys[slot] = keys[i];
+            map->values[slot] = values[i];
+            map->count++;
+        }
+    }
+
+    mem_free(keys);
+    mem_free(values);
+}
+
+uint32_t symbol_map_get(symbol_map_t* map, symbol_t symbol) {
+    size_t slot = find_slot(map, symbol);
+    return map->keys[slot] == symbol ? map->values[slot] : SYMBOL_MAP_NONE;
+}
+
+uint32_t symbol_map_put(symbol_map_t* map, symbol_t symbol, uint32_t value) {
+    size_t slot = find_slot(map, symbol);
+
+    if (map->keys[slot] == symbol) {
+        uint32_t previous = map->values[slot];
+        map->values[slot] = value;
+
+        return previous;
+    }
+
+    map->keys[slot] = symbol;
+    map->values[slot] = value;
+    map->count++;
+
+    // Kept at most half full so probe sequences stay short.
+    if (map->count * 2 > map->capacity) {
+        grow(map);
+    }
+
+    return SYMBOL_MAP_NONE;
+}
+
+// Backward-shift deletion: entries after the hole move up into it unless
+// that would put them before their home slot, so no tombstones are needed.
+void symbol_map_remove(symbol_map_t* map, symbol_t symbol) {
+    size_t mask = map->capacity - 1;
+    size_t hole = find_slot(map, symbol);
+
+    if (map->keys[hole] != symbol) {
+        return;
+    }
+
+    for (size_t slot = (hole + 1) & mask; map->keys[slot] != SYMBOL_NONE; slot = (slot + 1) & mask) {
+        size_t home = home_slot(map, map->keys[slot]);
+
+        // Move the entry if its home is not in (hole, slot], cyclically.
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            map->keys[hole] = map->keys[slot];
+            map->values[hole] = map->values[slot];
+            hole = slot;
+        }
+    }
+
+    map->keys[hole] = SYMBOL_NONE;
+    map->count--;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <interner.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SYMBOL_MAP_NONE UINT32_MAX
+
+// An open-addressing map from symbol to a 32-bit value, probed linearly.
+typedef struct {
+    symbol_t* keys;
+    uint32_t* values;
+
+    size_t capacity;
+    size_t count;
+    int shift;
+} symbol_map_t;
+
+void symbol_map_init(symbol_map_t*);
+void symbol_map_deinit(symbol_map_t*);
+
+// Removes every entry but keeps the capacity.
+void symbol_map_clear(symbol_map_t*);
+
+// Returns SYMBOL_MAP_NONE if the symbol is not in the map.
+uint32_t symbol_map_get(symbol_map_t*, symbol_t);
+
+// Returns the value it replaced, or SYMBOL_MAP_NONE.
+uint32_t symbol_map_put(symbol_map_t*, symbol_t, uint32_t);
+
+void symbol_map_remove(symbol_map_t*, symbol_t);
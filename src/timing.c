@@ -0,0 +1,103 @@
+#include <inttypes.h>
+#include <string.h>
+#include <timing.h>
+
+static const char* pass_names[PASS_COUNT] = {
+    [PASS_READ]       = "read",
+    [PASS_LEX]        = "lex",
+    [PASS_PARSE]      = "parse",
+    [PASS_SIGNATURES] = "signatures",
+    [PASS_CHECK]      = "check",
+    [PASS_FOLD]       = "fold",
+    [PASS_CODEGEN]    = "codegen",
+    [PASS_OUTPUT]     = "output",
+};
+
+void pass_report_init(pass_report_t* report) {
+    memset(report, 0, sizeof(pass_report_t));
+}
+
+pass_clock_t pass_begin(bool worker) {
+    pass_clock_t clock = {
+        .cpu_clock = worker ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID,
+    };
+
+    clock_gettime(CLOCK_MONOTONIC, &clock.wall);
+    clock_gettime(clock.cpu_clock, &clock.cpu);
+
+    return clock;
+}
+
+static double seconds_since(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+pass_time_t pass_elapsed(pass_clock_t start) {
+    struct timespec wall;
+    struct timespec cpu;
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    clock_gettime(start.cpu_clock, &cpu);
+
+    return (pass_time_t) {
+        .wall = seconds_since(start.wall, wall),
+        .cpu = seconds_since(start.cpu, cpu),
+    };
+}
+
+void pass_end(pass_report_t* report, pass_t pass, pass_clock_t start) {
+    pass_time_t time = pass_elapsed(start);
+
+    report->passes[pass].wall += time.wall;
+    report->passes[pass].cpu += time.cpu;
+}
+
+void pass_move(pass_report_t* report, pass_t from, pass_t to, pass_time_t time) {
+    pass_time_t* source = &report->passes[from];
+    double wall = time.wall < source->wall ? time.wall : source->wall;
+    double cpu = time.cpu < source->cpu ? time.cpu : source->cpu;
+
+    source->wall -= wall;
+    source->cpu -= cpu;
+    report->passes[to].wall += wall;
+    report->passes[to].cpu += cpu;
+}
+
+void pass_report_merge(pass_report_t* report, const pass_report_t* other) {
+    for (int i = 0; i < PASS_COUNT; i++) {
+        report->passes[i].wall += other->passes[i].wall;
+        report->passes[i].cpu += other->passes[i].cpu;
+    }
+
+    report->tokens += other->tokens;
+    report->nodes += other->nodes;
+    report->lookups += other->lookups;
+    report->instructions += other->instructions;
+}
+
+void pass_report_print(const pass_report_t* report, FILE* stream) {
+    pass_time_t total = { 0 };
+
+    fprintf(stream, "%-12s %12s %12s\n", "pass", "wall (ms)", "cpu (ms)");
+    for (int i = 0; i < PASS_COUNT; i++) {
+        fprintf(stream, "%-12s %12.3f %12.3f\n", pass_names[i], report->passes[i].wall * 1e3, report->passes[i].cpu * 1e3);
+        total.wall += report->passes[i].wall;
+        total.cpu += report->passes[i].cpu;
+    }
+    fprintf(stream, "%-12s %12.3f %12.3f\n", "total", total.wall * 1e3, total.cpu * 1e3);
+
+    fprintf(stream, "\n");
+    fprintf(stream, "%-12s %12"PRIu64"\n", "tokens", report->tokens);
+    fprintf(stream, "%-12s %12"PRIu64"\n", "nodes", report->nodes);
+    fprintf(stream, "%-12s %12"PRIu64"\n", "lookups", report->lookups);
+    fprintf(stream, "%-12s %12"PRIu64"\n", "instructions", report->instructions);
+}
+
+void pass_report_print_json(const pass_report_t* report, FILE* stream) {
+    fprintf(stream, "{\"passes\": {");
+    for (int i = 0; i < PASS_COUNT; i++) {
+        fprintf(stream, "%s\"%s\": {\"wall\": %.9f, \"cpu\": %.9f}", i ? ", " : "", pass_names[i], report->passes[i].wall, report->passes[i].cpu);
+    }
+
+    fprintf(stream, "}, \"counters\": {\"tokens\": %"PRIu64", \"nodes\": %"PRIu64", \"lookups\": %"PRIu64", \"instructions\": %"PRIu64"}}\n",
+            report->tokens, report->nodes, report->lookups, report->instructions);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// The phases of a compile, in the order they run.
+typedef enum {
+    PASS_READ,
+    PASS_LEX,
+    PASS_PARSE,
+    PASS_SIGNATURES,
+    PASS_CHECK,
+    PASS_FOLD,
+    PASS_CODEGEN,
+    PASS_OUTPUT,
+    PASS_COUNT,
+} pass_t;
+
+typedef struct {
+    double wall;
+    double cpu;
+} pass_time_t;
+
+// Seconds spent in each phase, summed over compiles. Check, fold and
+// codegen run on the workers, so theirs are summed over the workers too and
+// may exceed the wall time of the whole compile.
+typedef struct {
+    pass_time_t passes[PASS_COUNT];
+
+    uint64_t tokens;
+    uint64_t nodes;
+    uint64_t lookups;
+    uint64_t instructions;
+} pass_report_t;
+
+// A phase's start. Phases on the main thread are charged the process's CPU
+// time, which includes any threads it started; phases on a worker only
+// that worker's.
+typedef struct {
+    struct timespec wall;
+    struct timespec cpu;
+    clockid_t cpu_clock;
+} pass_clock_t;
+
+void pass_report_init(pass_report_t*);
+
+pass_clock_t pass_begin(bool);
+void pass_end(pass_report_t*, pass_t, pass_clock_t);
+
+// The time since `start`, for work that is summed before it is reported.
+pass_time_t pass_elapsed(pass_clock_t);
+
+// Moves time that was charged to one pass to another that ran inside it,
+// never leaving the first with less than nothing.
+void pass_move(pass_report_t*, pass_t, pass_t, pass_time_t);
+
+void pass_report_merge(pass_report_t*, const pass_report_t*);
+
+void pass_report_print(const pass_report_t*, FILE*);
+void pass_report_print_json(const pass_report_t*, FILE*);
@@ -1,3 +1,4 @@
+#include <dynarray/dynarray.h>
 #include <token.h>
 
 const char* token_kind_to_str(token_kind_t kind) {
@@ -59,6 +60,10 @@ const char* token_kind_to_str(token_kind_t kind) {
             return "<";
         case TOK_GREATER:
             return ">";
+        case TOK_LESS_EQUAL:
+            return "<=";
+        case TOK_GREATER_EQUAL:
+            return ">=";
 
         case TOK_PLUS:
             return "+";
@@ -68,13 +73,52 @@ const char* token_kind_to_str(token_kind_t kind) {
             return "*";
         case TOK_SLASH:
             return "/";
+
+        case TOK_COUNT:
+            break;
     }
+
+    return "unknown";
 }
 
-token_t token_make(token_kind_t kind, sv_t span, location_t location) {
+token_t token_make(token_kind_t kind, sv_t span) {
     return (token_t) {
         .kind = kind,
+        .symbol = SYMBOL_NONE,
         .span = span,
-        .location = location,
     };
 }
+
+void token_buffer_init(token_buffer_t* tokens) {
+    tokens->kinds   = dynarray_create(uint8_t);
+    tokens->starts  = dynarray_create(uint64_t);
+    tokens->lengths = dynarray_create(uint32_t);
+    tokens->symbols = dynarray_create(symbol_t);
+}
+
+void token_buffer_deinit(token_buffer_t* tokens) {
+    dynarray_destroy(tokens->kinds);
+    dynarray_destroy(tokens->starts);
+    dynarray_destroy(tokens->lengths);
+    dynarray_destroy(tokens->symbols);
+}
+
+void token_buffer_push(token_buffer_t* tokens, token_kind_t kind, uint64_t start, uint32_t length, symbol_t symbol) {
+    dynarray_push_rval(tokens->kinds, (uint8_t) kind);
+    dynarray_push_rval(tokens->starts, start);
+    dynarray_push_rval(tokens->lengths, length);
+    dynarray_push_rval(tokens->symbols, symbol);
+}
+
+void token_buffer_splice(token_buffer_t* tokens, size_t index, size_t remove, token_buffer_t* items) {
+    size_t count = token_buffer_length(items);
+
+    dynarray_splice(tokens->kinds, index, remove, items->kinds, count);
+    dynarray_splice(tokens->starts, index, remove, items->starts, count);
+    dynarray_splice(tokens->lengths, index, remove, items->lengths, count);
+    dynarray_splice(tokens->symbols, index, remove, items->symbols, count);
+}
+
+size_t token_buffer_length(token_buffer_t* tokens) {
+    return dynarray_length(tokens->kinds);
+}
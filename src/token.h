@@ -1,6 +1,9 @@
 #pragma once
 
 #include <common.h>
+#include <interner.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <sv/sv.h>
 
 typedef enum {
@@ -36,19 +39,40 @@ typedef enum {
 
     TOK_LESS,
     TOK_GREATER,
+    TOK_LESS_EQUAL,
+    TOK_GREATER_EQUAL,
 
     TOK_PLUS,
     TOK_MINUS,
     TOK_STAR,
     TOK_SLASH,
+
+    TOK_COUNT,
 } token_kind_t;
 
 const char* token_kind_to_str(token_kind_t);
 
+// `symbol` is the interned name of an identifier and SYMBOL_NONE otherwise.
 typedef struct {
     token_kind_t kind;
+    symbol_t symbol;
     sv_t span;
-    location_t location;
 } token_t;
 
-token_t token_make(token_kind_t, sv_t, location_t);
+token_t token_make(token_kind_t, sv_t);
+
+// A lexed token stream stored as parallel arrays. Offsets are relative to
+// the start of the input; locations are resolved through the lexer.
+typedef struct {
+    uint8_t* kinds;
+    uint64_t* starts;
+    uint32_t* lengths;
+    symbol_t* symbols;
+} token_buffer_t;
+
+void token_buffer_init(token_buffer_t*);
+void token_buffer_deinit(token_buffer_t*);
+
+void token_buffer_push(token_buffer_t*, token_kind_t, uint64_t, uint32_t, symbol_t);
+void token_buffer_splice(token_buffer_t*, size_t, size_t, token_buffer_t*);
+size_t token_buffer_length(token_buffer_t*);
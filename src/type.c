@@ -0,0 +1,45 @@
+#include <dynarray/dynarray.h>
+#include <type.h>
+
+static const type_info_t builtin_types[TYPE_BUILTIN_COUNT] = {
+    [TYPE_INT]   = { .name = SYMBOL_INT,   .size = 8, .flags = TYPE_FLAG_VARIABLE | TYPE_FLAG_RETURN | TYPE_FLAG_ARITH | TYPE_FLAG_LOGICAL | TYPE_FLAG_ORDERED },
+    [TYPE_FLOAT] = { .name = SYMBOL_FLOAT, .size = 8, .flags = TYPE_FLAG_VARIABLE | TYPE_FLAG_RETURN | TYPE_FLAG_ARITH | TYPE_FLAG_LOGICAL | TYPE_FLAG_ORDERED | TYPE_FLAG_FLOATING },
+    [TYPE_BOOL]  = { .name = SYMBOL_BOOL,  .size = 1, .flags = TYPE_FLAG_VARIABLE | TYPE_FLAG_RETURN | TYPE_FLAG_LOGICAL },
+    [TYPE_VOID]  = { .name = SYMBOL_VOID,  .size = 0, .flags = TYPE_FLAG_RETURN },
+};
+
+void type_table_init(type_table_t* table) {
+    table->types = dynarray_create(type_info_t);
+    symbol_map_init(&table->index);
+
+    for (int i = 0; i < TYPE_BUILTIN_COUNT; i++) {
+        type_table_add(table, builtin_types[i]);
+    }
+}
+
+void type_table_deinit(type_table_t* table) {
+    dynarray_destroy(table->types);
+    symbol_map_deinit(&table->index);
+}
+
+type_id_t type_table_add(type_table_t* table, type_info_t info) {
+    type_id_t id = dynarray_length(table->types);
+
+    symbol_map_put(&table->index, info.name, id);
+    dynarray_push(table->types, info);
+
+    return id;
+}
+
+type_id_t type_table_find(type_table_t* table, symbol_t name) {
+    uint32_t id = symbol_map_get(&table->index, name);
+    return id != SYMBOL_MAP_NONE ? id : TYPE_NONE;
+}
+
+type_info_t* type_info(type_table_t* table, type_id_t id) {
+    return &table->types[id];
+}
+
+bool type_has(type_table_t* table, type_id_t id, type_flag_t flag) {
+    return (table->types[id].flags & flag) != 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <interner.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <symbol_map.h>
+
+// Types are kept in one table and referred to by index, so checking copies
+// and compares 32-bit ids.
+typedef uint32_t type_id_t;
+
+#define TYPE_NONE UINT32_MAX
+
+// Registered first, in this order, so their ids are known constants.
+typedef enum {
+    TYPE_INT,
+    TYPE_FLOAT,
+    TYPE_BOOL,
+    TYPE_VOID,
+    TYPE_BUILTIN_COUNT,
+} builtin_type_t;
+
+// What values of a type may be used for.
+typedef enum {
+    TYPE_FLAG_VARIABLE  = 1 << 0,
+    TYPE_FLAG_RETURN    = 1 << 1,
+    TYPE_FLAG_ARITH     = 1 << 2,  // Operands of + - * /.
+    TYPE_FLAG_LOGICAL   = 1 << 3,  // Operands of comparisons, and, or.
+    TYPE_FLAG_ORDERED   = 1 << 4,  // Operands of < > <= >=.
+    TYPE_FLAG_FLOATING  = 1 << 5,
+} type_flag_t;
+
+typedef struct {
+    symbol_t name;
+    uint32_t flags;
+    uint32_t size;
+} type_info_t;
+
+// `index` maps a type's name to its id.
+typedef struct {
+    type_info_t* types;
+    symbol_map_t index;
+} type_table_t;
+
+void type_table_init(type_table_t*);
+void type_table_deinit(type_table_t*);
+
+type_id_t type_table_add(type_table_t*, type_info_t);
+
+// Returns TYPE_NONE if no type has that name.
+type_id_t type_table_find(type_table_t*, symbol_t);
+
+type_info_t* type_info(type_table_t*, type_id_t);
+bool type_has(type_table_t*, type_id_t, type_flag_t);
@@ -0,0 +1,444 @@
+#include <assert.h>
+#include <dynarray/dynarray.h>
+#include <x86.h>
+
+static const char* reg_names[REG_COUNT] = {
+    [REG_RAX] = "rax",
+    [REG_RBX] = "rbx",
+    [REG_RCX] = "rcx",
+    [REG_RDX] = "rdx",
+    [REG_RDI] = "rdi",
+    [REG_RSI] = "rsi",
+    [REG_RBP] = "rbp",
+    [REG_RSP] = "rsp",
+    [REG_R8]  = "r8",
+    [REG_R9]  = "r9",
+    [REG_R10] = "r10",
+    [REG_R11] = "r11",
+    [REG_R12] = "r12",
+    [REG_R13] = "r13",
+    [REG_R14] = "r14",
+    [REG_R15] = "r15",
+};
+
+static const char* reg_byte_names[REG_COUNT] = {
+    [REG_RAX] = "al",
+    [REG_RBX] = "bl",
+    [REG_RCX] = "cl",
+    [REG_RDX] = "dl",
+    [REG_RDI] = "dil",
+    [REG_RSI] = "sil",
+    [REG_RBP] = "bpl",
+    [REG_RSP] = "spl",
+    [REG_R8]  = "r8b",
+    [REG_R9]  = "r9b",
+    [REG_R10] = "r10b",
+    [REG_R11] = "r11b",
+    [REG_R12] = "r12b",
+    [REG_R13] = "r13b",
+    [REG_R14] = "r14b",
+    [REG_R15] = "r15b",
+};
+
+// The register numbers instructions encode.
+static const uint8_t reg_codes[REG_COUNT] = {
+    [REG_RAX] = 0,
+    [REG_RCX] = 1,
+    [REG_RDX] = 2,
+    [REG_RBX] = 3,
+    [REG_RSP] = 4,
+    [REG_RBP] = 5,
+    [REG_RSI] = 6,
+    [REG_RDI] = 7,
+    [REG_R8]  = 8,
+    [REG_R9]  = 9,
+    [REG_R10] = 10,
+    [REG_R11] = 11,
+    [REG_R12] = 12,
+    [REG_R13] = 13,
+    [REG_R14] = 14,
+    [REG_R15] = 15,
+};
+
+static const char* alu_names[] = {
+    [X86_ADD]  = "add",
+    [X86_SUB]  = "sub",
+    [X86_IMUL] = "imul",
+    [X86_AND]  = "and",
+    [X86_OR]   = "or",
+    [X86_CMP]  = "cmp",
+};
+
+// The register-to-register form, with the source in the reg field; imul has
+// its operands the other way round.
+static const uint16_t alu_opcodes[] = {
+    [X86_ADD]  = 0x01,
+    [X86_SUB]  = 0x29,
+    [X86_IMUL] = 0x0faf,
+    [X86_AND]  = 0x21,
+    [X86_OR]   = 0x09,
+    [X86_CMP]  = 0x39,
+};
+
+// The reg field of the immediate forms, 0x81 and 0x83.
+static const uint8_t alu_extensions[] = {
+    [X86_ADD] = 0,
+    [X86_SUB] = 5,
+    [X86_AND] = 4,
+    [X86_OR]  = 1,
+    [X86_CMP] = 7,
+};
+
+static const char* condition_names[] = {
+    [X86_EQUAL]         = "sete",
+    [X86_NOT_EQUAL]     = "setne",
+    [X86_LESS]          = "setl",
+    [X86_GREATER]       = "setg",
+    [X86_LESS_EQUAL]    = "setle",
+    [X86_GREATER_EQUAL] = "setge",
+};
+
+static const uint8_t condition_codes[] = {
+    [X86_EQUAL]         = 0x4,
+    [X86_NOT_EQUAL]     = 0x5,
+    [X86_LESS]          = 0xc,
+    [X86_GREATER]       = 0xf,
+    [X86_LESS_EQUAL]    = 0xe,
+    [X86_GREATER_EQUAL] = 0xd,
+};
+
+void x86_init(x86_t* x86) {
+    emitter_init(&x86->code);
+    x86->code.tag = MEM_CODEGEN;
+    x86->encode = false;
+    x86->calls = dynarray_create(x86_call_t);
+    x86->instructions = 0;
+}
+
+void x86_deinit(x86_t* x86) {
+    emitter_deinit(&x86->code);
+    dynarray_destroy(x86->calls);
+}
+
+void x86_clear(x86_t* x86) {
+    emitter_clear(&x86->code);
+    _dynarray_field_set(x86->calls, LENGTH, 0);
+    x86->instructions = 0;
+}
+
+static void emit_u8(x86_t* x86, uint8_t byte) {
+    emit_bytes(&x86->code, (const char*) &byte, 1);
+}
+
+static void emit_u32(x86_t* x86, uint32_t value) {
+    char bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+    emit_bytes(&x86->code, bytes, sizeof(bytes));
+}
+
+static void emit_u64(x86_t* x86, uint64_t value) {
+    emit_u32(x86, value);
+    emit_u32(x86, value >> 32);
+}
+
+// Two-byte opcodes are written with their 0x0f escape in the high byte.
+static void emit_opcode(x86_t* x86, uint16_t opcode) {
+    if (opcode > 0xff) {
+        emit_u8(x86, opcode >> 8);
+    }
+    emit_u8(x86, opcode);
+}
+
+// Byte registers past bl only exist with a REX prefix; without one the same
+// codes name ah through bh. `force` asks for the prefix when it is empty.
+static void emit_rex(x86_t* x86, bool wide, int reg, int base, bool force) {
+    uint8_t rex = 0x40 | (wide << 3) | ((reg >> 3) << 2) | (base >> 3);
+    if (rex != 0x40 || force) {
+        emit_u8(x86, rex);
+    }
+}
+
+// With `bytes`, rm names a byte register.
+static void encode_register(x86_t* x86, bool wide, uint16_t opcode, int reg, int rm, bool bytes) {
+    emit_rex(x86, wide, reg, rm, bytes && rm >= 4);
+    emit_opcode(x86, opcode);
+    emit_u8(x86, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// rsp and r12 as a base need a SIB byte; rbp and r13 always need a
+// displacement. With `bytes`, reg names a byte register.
+static void encode_memory(x86_t* x86, bool wide, uint16_t opcode, int reg, x86_memory_t memory, bool bytes) {
+    int base = reg_codes[memory.base];
+    int32_t displacement = memory.displacement;
+
+    emit_rex(x86, wide, reg, base, bytes && reg >= 4);
+    emit_opcode(x86, opcode);
+
+    int mod = 2;
+    if (displacement == 0 && (base & 7) != 5) {
+        mod = 0;
+    } else if (displacement >= INT8_MIN && displacement <= INT8_MAX) {
+        mod = 1;
+    }
+
+    emit_u8(x86, (mod << 6) | ((reg & 7) << 3) | (base & 7));
+
+    if ((base & 7) == 4) {
+        emit_u8(x86, 0x24);
+    }
+
+    if (mod == 1) {
+        emit_u8(x86, displacement);
+    } else if (mod == 2) {
+        emit_u32(x86, displacement);
+    }
+}
+
+static void text_memory(x86_t* x86, const char* size, x86_memory_t memory) {
+    emitf(&x86->code, "%s [%s", size, reg_names[memory.base]);
+
+    if (memory.displacement < 0) {
+        emitf(&x86->code, " - %d]", -memory.displacement);
+    } else if (memory.displacement > 0) {
+        emitf(&x86->code, " + %d]", memory.displacement);
+    } else {
+        emit_string(&x86->code, "]");
+    }
+}
+
+void x86_label(x86_t* x86, sv_t name) {
+    if (!x86->encode) {
+        emitf(&x86->code, SV_FMT":\n", SV_ARG(name));
+    }
+}
+
+void x86_mov(x86_t* x86, reg_t dst, reg_t src) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emitf(&x86->code, "mov %s, %s\n", reg_names[dst], reg_names[src]);
+        return;
+    }
+
+    encode_register(x86, true, 0x89, reg_codes[src], reg_codes[dst], false);
+}
+
+// Picks the shortest form: a 32-bit move zero-extends, the 0xc7 form
+// sign-extends its 32 bits, and anything else needs all 64.
+void x86_mov_immediate(x86_t* x86, reg_t dst, int64_t value) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emitf(&x86->code, "mov %s, %ld\n", reg_names[dst], value);
+        return;
+    }
+
+    int code = reg_codes[dst];
+
+    if (value >= 0 && value <= UINT32_MAX) {
+        emit_rex(x86, false, 0, code, false);
+        emit_u8(x86, 0xb8 + (code & 7));
+        emit_u32(x86, value);
+    } else if (value >= INT32_MIN && value <= INT32_MAX) {
+        encode_register(x86, true, 0xc7, 0, code, false);
+        emit_u32(x86, value);
+    } else {
+        emit_rex(x86, true, 0, code, false);
+        emit_u8(x86, 0xb8 + (code & 7));
+        emit_u64(x86, value);
+    }
+}
+
+void x86_load(x86_t* x86, reg_t dst, x86_memory_t src) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emitf(&x86->code, "mov %s, ", reg_names[dst]);
+        text_memory(x86, "qword", src);
+        emit_string(&x86->code, "\n");
+        return;
+    }
+
+    encode_memory(x86, true, 0x8b, reg_codes[dst], src, false);
+}
+
+void x86_store(x86_t* x86, x86_memory_t dst, reg_t src) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emit_string(&x86->code, "mov ");
+        text_memory(x86, "qword", dst);
+        emitf(&x86->code, ", %s\n", reg_names[src]);
+        return;
+    }
+
+    encode_memory(x86, true, 0x89, reg_codes[src], dst, false);
+}
+
+void x86_load_byte(x86_t* x86, reg_t dst, x86_memory_t src) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emitf(&x86->code, "movzx %s, ", reg_names[dst]);
+        text_memory(x86, "byte", src);
+        emit_string(&x86->code, "\n");
+        return;
+    }
+
+    encode_memory(x86, true, 0x0fb6, reg_codes[dst], src, false);
+}
+
+void x86_store_byte(x86_t* x86, x86_memory_t dst, reg_t src) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emit_string(&x86->code, "mov ");
+        text_memory(x86, "byte", dst);
+        emitf(&x86->code, ", %s\n", reg_byte_names[src]);
+        return;
+    }
+
+    encode_memory(x86, false, 0x88, reg_codes[src], dst, true);
+}
+
+void x86_zero_extend_byte(x86_t* x86, reg_t reg) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emitf(&x86->code, "movzx %s, %s\n", reg_names[reg], reg_byte_names[reg]);
+        return;
+    }
+
+    encode_register(x86, true, 0x0fb6, reg_codes[reg], reg_codes[reg], true);
+}
+
+void x86_push(x86_t* x86, reg_t reg) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emitf(&x86->code, "push %s\n", reg_names[reg]);
+        return;
+    }
+
+    emit_rex(x86, false, 0, reg_codes[reg], false);
+    emit_u8(x86, 0x50 + (reg_codes[reg] & 7));
+}
+
+void x86_pop(x86_t* x86, reg_t reg) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emitf(&x86->code, "pop %s\n", reg_names[reg]);
+        return;
+    }
+
+    emit_rex(x86, false, 0, reg_codes[reg], false);
+    emit_u8(x86, 0x58 + (reg_codes[reg] & 7));
+}
+
+void x86_alu(x86_t* x86, x86_alu_t op, reg_t dst, reg_t src) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emitf(&x86->code, "%s %s, %s\n", alu_names[op], reg_names[dst], reg_names[src]);
+        return;
+    }
+
+    if (op == X86_IMUL) {
+        encode_register(x86, true, alu_opcodes[op], reg_codes[dst], reg_codes[src], false);
+    } else {
+        encode_register(x86, true, alu_opcodes[op], reg_codes[src], reg_codes[dst], false);
+    }
+}
+
+void x86_alu_immediate(x86_t* x86, x86_alu_t op, reg_t dst, int32_t value) {
+    assert(op != X86_IMUL);
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emitf(&x86->code, "%s %s, %d\n", alu_names[op], reg_names[dst], value);
+        return;
+    }
+
+    if (value >= INT8_MIN && value <= INT8_MAX) {
+        encode_register(x86, true, 0x83, alu_extensions[op], reg_codes[dst], false);
+        emit_u8(x86, value);
+    } else {
+        encode_register(x86, true, 0x81, alu_extensions[op], reg_codes[dst], false);
+        emit_u32(x86, value);
+    }
+}
+
+void x86_set(x86_t* x86, x86_condition_t condition, reg_t dst) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emitf(&x86->code, "%s %s\n", condition_names[condition], reg_byte_names[dst]);
+        return;
+    }
+
+    encode_register(x86, false, 0x0f90 + condition_codes[condition], 0, reg_codes[dst], true);
+}
+
+void x86_cqo(x86_t* x86) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emit_string(&x86->code, "cqo\n");
+        return;
+    }
+
+    emit_u8(x86, 0x48);
+    emit_u8(x86, 0x99);
+}
+
+void x86_idiv(x86_t* x86, x86_memory_t divisor) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emit_string(&x86->code, "idiv ");
+        text_memory(x86, "qword", divisor);
+        emit_string(&x86->code, "\n");
+        return;
+    }
+
+    encode_memory(x86, true, 0xf7, 7, divisor, false);
+}
+
+void x86_call(x86_t* x86, symbol_t target, sv_t name) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emitf(&x86->code, "call "SV_FMT"\n", SV_ARG(name));
+        return;
+    }
+
+    emit_u8(x86, 0xe8);
+
+    x86_call_t call = { .offset = x86->code.size, .target = target };
+    dynarray_push(x86->calls, call);
+
+    emit_u32(x86, 0);
+}
+
+void x86_ret(x86_t* x86) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emit_string(&x86->code, "ret\n");
+        return;
+    }
+
+    emit_u8(x86, 0xc3);
+}
+
+void x86_syscall(x86_t* x86) {
+    x86->instructions++;
+
+    if (!x86->encode) {
+        emit_string(&x86->code, "syscall\n");
+        return;
+    }
+
+    emit_u8(x86, 0x0f);
+    emit_u8(x86, 0x05);
+}
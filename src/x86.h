@@ -0,0 +1,103 @@
+#pragma once
+
+#include <emitter.h>
+#include <interner.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sv/sv.h>
+
+typedef enum {
+    REG_NONE,
+    REG_RAX,
+    REG_RBX,
+    REG_RCX,
+    REG_RDX,
+    REG_RDI,
+    REG_RSI,
+    REG_RBP,
+    REG_RSP,
+    REG_R8,
+    REG_R9,
+    REG_R10,
+    REG_R11,
+    REG_R12,
+    REG_R13,
+    REG_R14,
+    REG_R15,
+    REG_COUNT,
+} reg_t;
+
+typedef enum {
+    X86_ADD,
+    X86_SUB,
+    X86_IMUL,
+    X86_AND,
+    X86_OR,
+    X86_CMP,
+} x86_alu_t;
+
+typedef enum {
+    X86_EQUAL,
+    X86_NOT_EQUAL,
+    X86_LESS,
+    X86_GREATER,
+    X86_LESS_EQUAL,
+    X86_GREATER_EQUAL,
+} x86_condition_t;
+
+// A qword or byte at `base` + `displacement`.
+typedef struct {
+    reg_t base;
+    int32_t displacement;
+} x86_memory_t;
+
+// A call whose rel32, at `offset` in the code, is filled in once every
+// function has its place.
+typedef struct {
+    uint32_t offset;
+    symbol_t target;
+} x86_call_t;
+
+// Instructions go to `code` either as NASM text or, with `encode`, as
+// machine code. Encoded calls are left for the linker in `calls`.
+typedef struct {
+    emitter_t code;
+    bool encode;
+
+    x86_call_t* calls;
+    uint64_t instructions;
+} x86_t;
+
+void x86_init(x86_t*);
+void x86_deinit(x86_t*);
+
+// Empties the code and calls, keeping their memory, and resets the count.
+void x86_clear(x86_t*);
+
+// Only emitted as text; encoded functions start where their code does.
+void x86_label(x86_t*, sv_t);
+
+void x86_mov(x86_t*, reg_t, reg_t);
+void x86_mov_immediate(x86_t*, reg_t, int64_t);
+void x86_load(x86_t*, reg_t, x86_memory_t);
+void x86_store(x86_t*, x86_memory_t, reg_t);
+
+// Byte loads zero-extend to the whole register.
+void x86_load_byte(x86_t*, reg_t, x86_memory_t);
+void x86_store_byte(x86_t*, x86_memory_t, reg_t);
+void x86_zero_extend_byte(x86_t*, reg_t);
+
+void x86_push(x86_t*, reg_t);
+void x86_pop(x86_t*, reg_t);
+
+void x86_alu(x86_t*, x86_alu_t, reg_t, reg_t);
+void x86_alu_immediate(x86_t*, x86_alu_t, reg_t, int32_t);
+void x86_set(x86_t*, x86_condition_t, reg_t);
+
+// Sign-extends rax into rdx and divides the pair by the qword in memory.
+void x86_cqo(x86_t*);
+void x86_idiv(x86_t*, x86_memory_t);
+
+void x86_call(x86_t*, symbol_t, sv_t);
+void x86_ret(x86_t*);
+void x86_syscall(x86_t*);
@@ -0,0 +1,191 @@
+#include <alloc.h>
+#include <dynarray/dynarray.h>
+#include <lexer.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Lexes each input once with SIMD skipping and once byte at a time and
+// expects the same tokens and line starts. Comments and whitespace runs are
+// placed to start, end and cross every offset of a 16- and 32-byte chunk.
+
+#define SKIP_EXIT_CODE 77
+
+typedef struct {
+    token_buffer_t tokens;
+    uint64_t* line_starts;
+} lexed_t;
+
+static void lex(const char* input, size_t size, bool scalar, lexed_t* lexed) {
+    lexer_t lexer;
+    lexer_init(&lexer, input, size);
+    lexer.quiet = true;
+    lexer.scalar = scalar;
+
+    token_buffer_init(&lexed->tokens);
+    get_tokens(&lexer, &lexed->tokens);
+
+    lexed->line_starts = lexer.line_starts;
+    lexer.line_starts = dynarray_create(uint64_t);
+    lexer_deinit(&lexer);
+}
+
+static void lexed_deinit(lexed_t* lexed) {
+    token_buffer_deinit(&lexed->tokens);
+    dynarray_destroy(lexed->line_starts);
+}
+
+static bool same_tokens(token_buffer_t* a, token_buffer_t* b) {
+    size_t count = token_buffer_length(a);
+    if (count != token_buffer_length(b)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (a->kinds[i] != b->kinds[i] || a->starts[i] != b->starts[i] || a->lengths[i] != b->lengths[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool same_lines(uint64_t* a, uint64_t* b) {
+    size_t count = dynarray_length(a);
+    return count == dynarray_length(b) && memcmp(a, b, count * sizeof(uint64_t)) == 0;
+}
+
+static int failures;
+static int cases;
+
+// The input is copied to a buffer of exactly its size, so a read past the
+// end shows up under a sanitizer.
+static void check(const char* name, const char* text, size_t size) {
+    char* input = malloc(size ? size : 1);
+    memcpy(input, text, size);
+
+    lexed_t simd;
+    lexed_t scalar;
+    lex(input, size, false, &simd);
+    lex(input, size, true, &scalar);
+
+    cases++;
+    if (!same_tokens(&simd.tokens, &scalar.tokens)) {
+        fprintf(stderr, "FAIL: %s: tokens differ for \"%.*s\"\n", name, (int) size, input);
+        failures++;
+    } else if (!same_lines(simd.line_starts, scalar.line_starts)) {
+        fprintf(stderr, "FAIL: %s: line starts differ for \"%.*s\"\n", name, (int) size, input);
+        failures++;
+    }
+
+    lexed_deinit(&simd);
+    lexed_deinit(&scalar);
+    free(input);
+}
+
+#define MAX_PADDING 70
+#define MAX_INPUT 512
+
+static const size_t comment_lengths[] = { 0, 1, 13, 14, 15, 16, 17, 30, 31, 32, 33, 47, 63, 64, 65, 97 };
+
+#define COMMENT_LENGTH_COUNT (sizeof(comment_lengths) / sizeof(comment_lengths[0]))
+
+static size_t append(char* buffer, size_t size, const char* text) {
+    size_t length = strlen(text);
+    memcpy(buffer + size, text, length);
+    return size + length;
+}
+
+static size_t append_repeated(char* buffer, size_t size, char c, size_t count) {
+    memset(buffer + size, c, count);
+    return size + count;
+}
+
+static void check_comments(const char* newline, bool at_eof) {
+    char buffer[MAX_INPUT];
+
+    for (size_t padding = 0; padding <= MAX_PADDING; padding++) {
+        for (size_t i = 0; i < COMMENT_LENGTH_COUNT; i++) {
+            size_t size = append_repeated(buffer, 0, ' ', padding);
+            size = append(buffer, size, "# ");
+            size = append_repeated(buffer, size, 'c', comment_lengths[i]);
+
+            if (!at_eof) {
+                size = append(buffer, size, newline);
+                size = append(buffer, size, "let x = 1;");
+                size = append(buffer, size, newline);
+            }
+
+            check(at_eof ? "comment at eof" : "comment", buffer, size);
+        }
+    }
+}
+
+// Runs of every whitespace byte, so newlines fall on each lane of a chunk.
+static void check_whitespace(void) {
+    static const char whitespace[] = " \t\r\n\v\f";
+    char buffer[MAX_INPUT];
+
+    for (size_t offset = 0; offset < sizeof(whitespace) - 1; offset++) {
+        for (size_t length = 0; length <= MAX_PADDING; length++) {
+            size_t size = append(buffer, 0, "a");
+            for (size_t i = 0; i < length; i++) {
+                buffer[size++] = whitespace[(offset + i) % (sizeof(whitespace) - 1)];
+            }
+            size = append(buffer, size, "b");
+
+            check("whitespace", buffer, size);
+            check("trailing whitespace", buffer, size - 1);
+        }
+    }
+}
+
+static void check_program(const char* newline) {
+    char buffer[MAX_INPUT];
+
+    for (size_t indent = 0; indent <= MAX_PADDING / 2; indent++) {
+        size_t size = append(buffer, 0, "def f(x: int): int {");
+        size = append(buffer, size, newline);
+        size = append_repeated(buffer, size, ' ', indent);
+        size = append(buffer, size, "# doubles x, then adds one");
+        size = append(buffer, size, newline);
+        size = append_repeated(buffer, size, '\t', indent);
+        size = append(buffer, size, "return x * 2 + 1;");
+        size = append(buffer, size, newline);
+        size = append(buffer, size, "}");
+        size = append(buffer, size, newline);
+        size = append(buffer, size, "# end");
+
+        check("program", buffer, size);
+    }
+}
+
+int main(void) {
+    mem_init(false);
+
+#ifdef __AVX2__
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("avx2")) {
+        fprintf(stderr, "SKIP: this CPU has no AVX2\n");
+        return SKIP_EXIT_CODE;
+    }
+#endif
+
+    check("empty", "", 0);
+
+    check_comments("\n", false);
+    check_comments("\r\n", false);
+    check_comments("\n", true);
+    check_whitespace();
+    check_program("\n");
+    check_program("\r\n");
+
+    if (failures) {
+        fprintf(stderr, "%d of %d cases failed\n", failures, cases);
+        return EXIT_FAILURE;
+    }
+
+    printf("%d cases passed\n", cases);
+    return EXIT_SUCCESS;
+}